@@ -3,102 +3,814 @@
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include <cstdint>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <queue>
+#include <bit>
+#include <climits>
+#include <deque>
+#include <fstream>
 using namespace std;
 using namespace chrono;
 
-struct Item {
-    int weight;
-    int value;
+typedef vector<uint64_t> Chromosome;
+
+const int WORD_BITS = 64;
+const int MAX_DIMS = 64;
+
+// One d-dimensional knapsack instance, stored as a structure of arrays.
+// Values and the weights of each dimension are flat columns padded to a
+// whole number of words, so addSegment() can run over a word's 64 items
+// without a tail check; weightRows repeats the weights item by item so
+// adding or removing one item touches d contiguous ints. ratioOrder
+// lists the items by value per unit of capacity used, best first.
+struct Instance {
+    int id = 0;
+    int dims = 1;
+    int n = 0;
+    int words = 0;
+    vector<int> capacity;
+    vector<int> itemValue;
+    vector<int> itemWeight;
+    vector<int> weightRows;
+    vector<int> ratioOrder;
+    vector<int> minItemWeight;
+    Chromosome greedySeed;
+};
+
+// One generation in a single preallocated arena: the genes of
+// individual i are words [i * words, (i + 1) * words), with its cached
+// totals alongside (dims weights per individual). Two arenas are
+// swapped every generation.
+struct Population {
+    int size = 0;
+    int words = 0;
+    int dims = 1;
+    vector<uint64_t> genes;
+    vector<int> weight;
+    vector<int> value;
+};
+
+struct Options {
+    int generations = 1000;
+    int populationSize = 500;
+    long long timeMs = 0;
+    int stallGenerations = 0;
+    double minDiversity = 0;
+    bool progress = false;
+    int threads = 1;
+    int dims = 1;
+    bool hasSeed = false;
+    uint64_t seed = 0;
+    int islands = 1;
+    int migrationInterval = 25;
+    int migrants = 2;
+    bool randomTopology = false;
+    bool exact = false;
+    bool seedGreedy = false;
+    bool repair = false;
+    bool ratioInit = false;
+    int localSearch = 0;
+    long long dpLimitMb = 512;
+    long long nodeLimit = 20000000;
+    bool batch = false;
+    string input;
+};
+
+struct Progress {
+    int generation;
+    double elapsedMs;
+    int bestValue;
+};
+
+// Called whenever the best value improves, so a caller can use the
+// best-so-far answer before the run finishes.
+typedef function<void(const Progress&)> ProgressCallback;
+
+// xorshift64* seeded through splitmix64. Every worker owns one, so the
+// streams never interleave and a run is reproducible from its seed.
+struct Rng {
+    uint64_t state;
+
+    explicit Rng(uint64_t seed = 0) {
+        uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        state = (z ^ (z >> 31)) | 1;
+    }
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+};
+
+// Persistent worker threads. run() calls job(t) once for every t in
+// [0, size()), with t = 0 on the calling thread, and returns when all
+// of them have finished. The job is passed to the workers as a plain
+// pointer and a call thunk, so a run allocates nothing.
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) : task(nullptr), invoke(nullptr), generation(0), pending(0), stopping(false) {
+        for (int t = 1; t < threads; t++) {
+            workers.emplace_back([this, t]() { workerLoop(t); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        startCv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int size() const {
+        return (int)workers.size() + 1;
+    }
+
+    template <class Job>
+    void run(const Job& job) {
+        if (workers.empty()) {
+            job(0);
+            return;
+        }
+        {
+            lock_guard<mutex> lock(mtx);
+            task = &job;
+            invoke = [](const void* job, int t) { (*(const Job*)job)(t); };
+            pending = (int)workers.size();
+            generation++;
+        }
+        startCv.notify_all();
+        job(0);
+        unique_lock<mutex> lock(mtx);
+        doneCv.wait(lock, [this]() { return pending == 0; });
+        task = nullptr;
+        invoke = nullptr;
+    }
+
+private:
+    void workerLoop(int t) {
+        int seen = 0;
+        while (true) {
+            const void* job;
+            void (*call)(const void*, int);
+            {
+                unique_lock<mutex> lock(mtx);
+                startCv.wait(lock, [this, seen]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                job = task;
+                call = invoke;
+            }
+            call(job, t);
+            {
+                lock_guard<mutex> lock(mtx);
+                pending--;
+            }
+            doneCv.notify_one();
+        }
+    }
+
+    vector<thread> workers;
+    mutex mtx;
+    condition_variable startCv, doneCv;
+    const void* task;
+    void (*invoke)(const void*, int);
+    int generation;
+    int pending;
+    bool stopping;
 };
 
-int m, n;
-vector<Item> items;
+int randomInt(Rng& rng, int min, int max) {
+    return min + (int)(rng.next() % (uint64_t)(max - min + 1));
+}
+
+// First index of slice t when count elements are split into parts slices.
+int sliceBegin(int count, int t, int parts) {
+    return (int)((long long)count * t / parts);
+}
+
+bool getGene(const uint64_t* genes, int i) {
+    return (genes[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+}
+
+void setGene(uint64_t* genes, int i) {
+    genes[i / WORD_BITS] |= 1ULL << (i % WORD_BITS);
+}
 
-int randomInt(int min, int max) {
-    return min + (rand() % (max - min + 1));
+void flipGene(uint64_t* genes, int i) {
+    genes[i / WORD_BITS] ^= 1ULL << (i % WORD_BITS);
 }
 
-int fitness(const vector<int>& solution) {
-    int totalWeight = 0, totalValue = 0;
-    for (int i = 0; i < n; i++) {
-        if (solution[i]) {
-            totalWeight += items[i].weight;
-            totalValue += items[i].value;
+void allocatePopulation(Population& population, int size, int words, int dims) {
+    population.size = size;
+    population.words = words;
+    population.dims = dims;
+    population.genes.assign((size_t)size * words, 0);
+    population.weight.assign((size_t)size * dims, 0);
+    population.value.assign(size, 0);
+}
+
+uint64_t* genesOf(Population& population, int i) {
+    return &population.genes[(size_t)i * population.words];
+}
+
+const uint64_t* genesOf(const Population& population, int i) {
+    return &population.genes[(size_t)i * population.words];
+}
+
+int* weightOf(Population& population, int i) {
+    return &population.weight[(size_t)i * population.dims];
+}
+
+const int* weightOf(const Population& population, int i) {
+    return &population.weight[(size_t)i * population.dims];
+}
+
+void copyIndividual(const Population& from, int i, Population& to, int j) {
+    copy(genesOf(from, i), genesOf(from, i) + from.words, genesOf(to, j));
+    copy(weightOf(from, i), weightOf(from, i) + from.dims, weightOf(to, j));
+    to.value[j] = from.value[i];
+}
+
+const int* rowOf(const Instance& kp, int item) {
+    return &kp.weightRows[(size_t)item * kp.dims];
+}
+
+bool fits(const Instance& kp, const int* weight) {
+    for (int k = 0; k < kp.dims; k++) {
+        if (weight[k] > kp.capacity[k]) return false;
+    }
+    return true;
+}
+
+bool fitsWith(const Instance& kp, const int* weight, int item) {
+    const int* row = rowOf(kp, item);
+    for (int k = 0; k < kp.dims; k++) {
+        if (weight[k] + row[k] > kp.capacity[k]) return false;
+    }
+    return true;
+}
+
+// Adds (sign = 1) or removes (sign = -1) item's weights.
+void addRow(const Instance& kp, int* weight, int item, int sign) {
+    const int* row = rowOf(kp, item);
+    for (int k = 0; k < kp.dims; k++) {
+        weight[k] += sign * row[k];
+    }
+}
+
+void buildItemColumns(Instance& kp) {
+    kp.words = (kp.n + WORD_BITS - 1) / WORD_BITS;
+    int stride = kp.words * WORD_BITS;
+    kp.itemWeight.assign((size_t)kp.dims * stride, 0);
+    kp.itemValue.resize(stride, 0);
+    for (int k = 0; k < kp.dims; k++) {
+        for (int i = 0; i < kp.n; i++) {
+            kp.itemWeight[(size_t)k * stride + i] = kp.weightRows[(size_t)i * kp.dims + k];
+        }
+    }
+}
+
+// Items are ranked by value over their surrogate load, the sum of their
+// weights as fractions of each capacity. With one dimension this is the
+// plain value/weight ratio. Weightless items come first, and equal
+// ratios fall back to the index, so the order is total even when both
+// cross products are 0.
+void buildRatioOrder(Instance& kp) {
+    vector<double> load(kp.n, 0.0);
+    for (int i = 0; i < kp.n; i++) {
+        for (int k = 0; k < kp.dims; k++) {
+            load[i] += (double)rowOf(kp, i)[k] / max(kp.capacity[k], 1);
+        }
+    }
+    kp.ratioOrder.resize(kp.n);
+    for (int i = 0; i < kp.n; i++) {
+        kp.ratioOrder[i] = i;
+    }
+    sort(kp.ratioOrder.begin(), kp.ratioOrder.end(), [&](int a, int b) {
+        bool freeA = load[a] == 0, freeB = load[b] == 0;
+        if (freeA != freeB) return freeA;
+        if (freeA) {
+            if (kp.itemValue[a] != kp.itemValue[b]) return kp.itemValue[a] > kp.itemValue[b];
+        }
+        else {
+            double lhs = kp.itemValue[a] * load[b], rhs = kp.itemValue[b] * load[a];
+            if (lhs != rhs) return lhs > rhs;
+        }
+        return a < b;
+    });
+    kp.minItemWeight.assign(kp.dims, INT_MAX);
+    for (int i = 0; i < kp.n; i++) {
+        for (int k = 0; k < kp.dims; k++) {
+            kp.minItemWeight[k] = min(kp.minItemWeight[k], rowOf(kp, i)[k]);
+        }
+    }
+}
+
+// Greedy fill in ratio order: the integral part of the LP relaxation,
+// topped up with any later item that still fits.
+Chromosome greedySolution(const Instance& kp) {
+    Chromosome solution(kp.words, 0);
+    int weight[MAX_DIMS] = {};
+    for (int i : kp.ratioOrder) {
+        if (fitsWith(kp, weight, i)) {
+            addRow(kp, weight, i, 1);
+            setGene(solution.data(), i);
+        }
+    }
+    return solution;
+}
+
+// Adds the weights (one per dimension) and value of the selected items
+// in [from, to).
+void addSegment(const Instance& kp, const uint64_t* genes, int from, int to, int* totalWeight, int& totalValue) {
+    if (from >= to) return;
+    int firstWord = from / WORD_BITS;
+    int lastWord = (to - 1) / WORD_BITS;
+    size_t stride = (size_t)kp.words * WORD_BITS;
+    for (int w = firstWord; w <= lastWord; w++) {
+        uint64_t word = genes[w];
+        if (w == firstWord) word &= ~0ULL << (from % WORD_BITS);
+        if (w == lastWord) word &= ~0ULL >> (WORD_BITS - 1 - (to - 1) % WORD_BITS);
+        if (word == 0) continue;
+        // Branch-free masked sums; the compiler vectorizes these loops,
+        // one column (one dimension) at a time.
+        int mask[WORD_BITS];
+        for (int b = 0; b < WORD_BITS; b++) {
+            mask[b] = -(int)((word >> b) & 1);
+        }
+        const int* value = &kp.itemValue[w * WORD_BITS];
+        for (int b = 0; b < WORD_BITS; b++) {
+            totalValue += value[b] & mask[b];
+        }
+        for (int k = 0; k < kp.dims; k++) {
+            const int* weight = &kp.itemWeight[k * stride + w * WORD_BITS];
+            int sum = 0;
+            for (int b = 0; b < WORD_BITS; b++) {
+                sum += weight[b] & mask[b];
+            }
+            totalWeight[k] += sum;
         }
     }
-    return (totalWeight <= m) ? totalValue : 0;
 }
 
-vector<int> selectParent(const vector<vector<int>>& population, const vector<int>& fitnessVal) {
-    int bestIdx = randomInt(0, population.size() - 1);
+void evaluate(const Instance& kp, Population& population, int i) {
+    int* weight = weightOf(population, i);
+    fill(weight, weight + kp.dims, 0);
+    population.value[i] = 0;
+    addSegment(kp, genesOf(population, i), 0, kp.n, weight, population.value[i]);
+}
+
+int fitness(const Instance& kp, const Population& population, int i) {
+    return fits(kp, weightOf(population, i)) ? population.value[i] : 0;
+}
+
+int selectParent(const vector<int>& fitnessVal, Rng& rng) {
+    int bestIdx = randomInt(rng, 0, fitnessVal.size() - 1);
     for (int i = 1; i < 3; i++) {
-        int idx = randomInt(0, population.size() - 1);
+        int idx = randomInt(rng, 0, fitnessVal.size() - 1);
         if (fitnessVal[idx] > fitnessVal[bestIdx]) {
             bestIdx = idx;
         }
     }
-    return population[bestIdx];
+    return bestIdx;
 }
 
-vector<int> crossover(const vector<int>& parent1, const vector<int>& parent2) {
-    int point = randomInt(0, n - 1);
-    vector<int> child(n);
-    for (int i = 0; i < n; i++) {
-        child[i] = (i < point) ? parent1[i] : parent2[i];
+// Writes the child of parents[p1] and parents[p2] into children[c]. The
+// child's totals come from the parents' cached totals plus the sums over
+// whichever side of the cut point is shorter.
+void crossover(const Instance& kp, const Population& parents, int p1, int p2, Population& children, int c, Rng& rng) {
+    int point = randomInt(rng, 0, kp.n - 1);
+    int pointWord = point / WORD_BITS;
+    uint64_t lowMask = (1ULL << (point % WORD_BITS)) - 1;
+    const uint64_t* parent1 = genesOf(parents, p1);
+    const uint64_t* parent2 = genesOf(parents, p2);
+    uint64_t* child = genesOf(children, c);
+    for (int w = 0; w < pointWord; w++) {
+        child[w] = parent1[w];
+    }
+    child[pointWord] = (parent1[pointWord] & lowMask) | (parent2[pointWord] & ~lowMask);
+    for (int w = pointWord + 1; w < kp.words; w++) {
+        child[w] = parent2[w];
+    }
+
+    int weight1[MAX_DIMS] = {}, weight2[MAX_DIMS] = {};
+    int value1 = 0, value2 = 0;
+    // base is the parent whose cached totals cover the longer side.
+    int base;
+    if (point < kp.n - point) {
+        addSegment(kp, parent1, 0, point, weight1, value1);
+        addSegment(kp, parent2, 0, point, weight2, value2);
+        base = p2;
+        children.value[c] = parents.value[p2] - value2 + value1;
+    }
+    else {
+        addSegment(kp, parent1, point, kp.n, weight1, value1);
+        addSegment(kp, parent2, point, kp.n, weight2, value2);
+        base = p1;
+        children.value[c] = parents.value[p1] - value1 + value2;
+    }
+    const int* baseWeight = weightOf(parents, base);
+    int* childWeight = weightOf(children, c);
+    for (int k = 0; k < kp.dims; k++) {
+        childWeight[k] = (base == p2)
+            ? baseWeight[k] - weight2[k] + weight1[k]
+            : baseWeight[k] - weight1[k] + weight2[k];
     }
-    return child;
 }
 
-void mutate(vector<int>& solution) {
-    int idx = randomInt(0, n - 1);
-    solution[idx] = 1 - solution[idx];
+void mutate(const Instance& kp, Population& population, int i, Rng& rng) {
+    int idx = randomInt(rng, 0, kp.n - 1);
+    uint64_t* genes = genesOf(population, i);
+    flipGene(genes, idx);
+    int sign = getGene(genes, idx) ? 1 : -1;
+    addRow(kp, weightOf(population, i), idx, sign);
+    population.value[i] += sign * kp.itemValue[idx];
 }
 
-void initializePopulation(vector<vector<int>>& population, int populationSize) {
-    for (int i = 0; i < populationSize; i++) {
-        vector<int> individual(n);
-        int currentWeight = 0;
-        for (int j = 0; j < n; j++) {
-            individual[j] = randomInt(0, 1);
-            if (individual[j]) {
-                currentWeight += items[j].weight;
-                if (currentWeight > m) {
-                    individual[j] = 0; 
+// True if some dimension has less room left than its lightest item, so
+// no further item can fit.
+bool isFull(const Instance& kp, const int* weight) {
+    for (int k = 0; k < kp.dims; k++) {
+        if (kp.capacity[k] - weight[k] < kp.minItemWeight[k]) return true;
+    }
+    return false;
+}
+
+// Drops the worst-ratio items of an overweight individual until it fits
+// every capacity, then adds the best-ratio items that still fit. Both
+// passes walk the presorted ratioOrder and update the cached totals as
+// they go.
+void repair(const Instance& kp, Population& population, int i) {
+    uint64_t* genes = genesOf(population, i);
+    int* weight = weightOf(population, i);
+    int& value = population.value[i];
+    for (int k = kp.n - 1; k >= 0 && !fits(kp, weight); k--) {
+        int item = kp.ratioOrder[k];
+        if (getGene(genes, item)) {
+            flipGene(genes, item);
+            addRow(kp, weight, item, -1);
+            value -= kp.itemValue[item];
+        }
+    }
+    for (int k = 0; k < kp.n && !isFull(kp, weight); k++) {
+        int item = kp.ratioOrder[k];
+        if (!getGene(genes, item) && fitsWith(kp, weight, item)) {
+            setGene(genes, item);
+            addRow(kp, weight, item, 1);
+            value += kp.itemValue[item];
+        }
+    }
+}
+
+// With greedy seeding, every other slot starts from the greedy solution;
+// slot 0 keeps it unchanged and the rest get a few random flips.
+void initializeIndividual(const Instance& kp, const Options& options, Population& population, int i, Rng& rng) {
+    uint64_t* genes = genesOf(population, i);
+    if (!kp.greedySeed.empty() && i % 2 == 0) {
+        copy(kp.greedySeed.begin(), kp.greedySeed.end(), genes);
+        int flips = (i == 0) ? 0 : randomInt(rng, 1, 3);
+        for (int f = 0; f < flips; f++) {
+            flipGene(genes, randomInt(rng, 0, kp.n - 1));
+        }
+        evaluate(kp, population, i);
+        return;
+    }
+
+    fill(genes, genes + kp.words, 0);
+    int currentWeight[MAX_DIMS] = {};
+    if (options.ratioInit) {
+        // The k-th best ratio is tried with probability (n - k) / n.
+        for (int k = 0; k < kp.n; k++) {
+            int item = kp.ratioOrder[k];
+            if (randomInt(rng, 0, kp.n - 1) >= k && fitsWith(kp, currentWeight, item)) {
+                addRow(kp, currentWeight, item, 1);
+                setGene(genes, item);
+            }
+        }
+        evaluate(kp, population, i);
+        return;
+    }
+
+    for (int j = 0; j < kp.n; j++) {
+        if (randomInt(rng, 0, 1)) {
+            addRow(kp, currentWeight, j, 1);
+            if (fits(kp, currentWeight)) {
+                setGene(genes, j);
+            }
+        }
+    }
+    evaluate(kp, population, i);
+}
+
+void initializePopulation(const Instance& kp, const Options& options, Population& population, WorkerPool& pool, vector<Rng>& rngs) {
+    pool.run([&](int t) {
+        int end = sliceBegin(population.size, t + 1, pool.size());
+        for (int i = sliceBegin(population.size, t, pool.size()); i < end; i++) {
+            initializeIndividual(kp, options, population, i, rngs[t]);
+        }
+    });
+}
+
+// Fills newPopulation[2 * from, 2 * to) with mutated children of parents
+// picked from population by tournament. Nothing is allocated: parents are
+// referenced by index and children are written into their slots.
+void breedPairs(const Instance& kp, const Options& options, const Population& population, const vector<int>& fitnessValues,
+    Population& newPopulation, int from, int to, Rng& rng) {
+    for (int i = from; i < to; i++) {
+        int parent1 = selectParent(fitnessValues, rng);
+        int parent2 = selectParent(fitnessValues, rng);
+
+        crossover(kp, population, parent1, parent2, newPopulation, 2 * i, rng);
+        mutate(kp, newPopulation, 2 * i, rng);
+        if (options.repair) {
+            repair(kp, newPopulation, 2 * i);
+        }
+
+        if (2 * i + 1 < newPopulation.size) {
+            crossover(kp, population, parent2, parent1, newPopulation, 2 * i + 1, rng);
+            mutate(kp, newPopulation, 2 * i + 1, rng);
+            if (options.repair) {
+                repair(kp, newPopulation, 2 * i + 1);
+            }
+        }
+    }
+}
+
+// Per-thread buffers for localSearch(), sized once to n. slot[item] is
+// the item's index in whichever of inside/outside holds it.
+struct LocalSearchScratch {
+    vector<int> inside;
+    vector<int> outside;
+    vector<int> slot;
+};
+
+void allocateScratch(const Instance& kp, LocalSearchScratch& scratch) {
+    scratch.inside.reserve(kp.n);
+    scratch.outside.reserve(kp.n);
+    scratch.slot.resize(kp.n);
+}
+
+// Candidates tried per move on each side, and move checks per elite.
+const int LOCAL_SEARCH_WINDOW = 32;
+const long long LOCAL_SEARCH_BUDGET = 1 << 16;
+
+void moveItem(vector<int>& from, vector<int>& to, vector<int>& slot, int item) {
+    int last = from.back();
+    from[slot[item]] = last;
+    slot[last] = slot[item];
+    from.pop_back();
+    slot[item] = (int)to.size();
+    to.push_back(item);
+}
+
+// First-improvement hill climbing on a feasible individual with 1-flip
+// (add an item) and 2-swap (add one item, drop another) moves. Each move
+// looks at a window of LOCAL_SEARCH_WINDOW items outside and inside the
+// knapsack, checking every candidate in O(d) against the cached totals,
+// and the lists are updated in O(1) after a flip. A window without an
+// improvement slides on; the climb stops once the windows have covered
+// both lists without improving or after LOCAL_SEARCH_BUDGET checks.
+void localSearch(const Instance& kp, Population& population, int i, LocalSearchScratch& scratch) {
+    uint64_t* genes = genesOf(population, i);
+    int* weight = weightOf(population, i);
+    int& value = population.value[i];
+    if (!fits(kp, weight)) return;
+
+    // Outside in ratio order and inside in reverse, so the first windows
+    // try the most promising additions against the weakest items.
+    vector<int>& inside = scratch.inside;
+    vector<int>& outside = scratch.outside;
+    inside.clear();
+    outside.clear();
+    for (int k = 0; k < kp.n; k++) {
+        int item = kp.ratioOrder[k];
+        if (!getGene(genes, item)) {
+            scratch.slot[item] = (int)outside.size();
+            outside.push_back(item);
+        }
+        item = kp.ratioOrder[kp.n - 1 - k];
+        if (getGene(genes, item)) {
+            scratch.slot[item] = (int)inside.size();
+            inside.push_back(item);
+        }
+    }
+
+    long long checks = 0;
+    int addFrom = 0, dropFrom = 0;
+    long long failedSpan = 0;
+    while (checks < LOCAL_SEARCH_BUDGET && !outside.empty()
+        && failedSpan < (long long)max(outside.size(), inside.size())) {
+        bool improved = false;
+        int outCount = (int)outside.size(), inCount = (int)inside.size();
+        int addWindow = min(LOCAL_SEARCH_WINDOW, outCount);
+        int dropWindow = min(LOCAL_SEARCH_WINDOW, inCount);
+
+        for (int a = 0; !improved && a < addWindow; a++) {
+            int add = outside[(addFrom + a) % outCount];
+            checks++;
+            if (kp.itemValue[add] > 0 && fitsWith(kp, weight, add)) {
+                setGene(genes, add);
+                addRow(kp, weight, add, 1);
+                value += kp.itemValue[add];
+                moveItem(outside, inside, scratch.slot, add);
+                improved = true;
+            }
+        }
+
+        for (int a = 0; !improved && a < addWindow; a++) {
+            int add = outside[(addFrom + a) % outCount];
+            for (int d = 0; !improved && d < dropWindow; d++) {
+                int drop = inside[(dropFrom + d) % inCount];
+                checks++;
+                if (kp.itemValue[add] <= kp.itemValue[drop]) continue;
+                addRow(kp, weight, drop, -1);
+                if (fitsWith(kp, weight, add)) {
+                    flipGene(genes, add);
+                    flipGene(genes, drop);
+                    addRow(kp, weight, add, 1);
+                    value += kp.itemValue[add] - kp.itemValue[drop];
+                    moveItem(outside, inside, scratch.slot, add);
+                    moveItem(inside, outside, scratch.slot, drop);
+                    improved = true;
+                }
+                else {
+                    addRow(kp, weight, drop, 1);
                 }
             }
         }
-        population.push_back(individual);
+
+        if (improved) {
+            failedSpan = 0;
+        }
+        else {
+            addFrom = (addFrom + addWindow) % outCount;
+            dropFrom = inCount > 0 ? (dropFrom + dropWindow) % inCount : 0;
+            failedSpan += LOCAL_SEARCH_WINDOW;
+        }
+    }
+}
+
+// Runs localSearch() on the options.localSearch fittest members of
+// population; order is scratch space of population.size entries.
+void improveElites(const Instance& kp, const Options& options, Population& population, vector<int>& order, WorkerPool* pool, vector<LocalSearchScratch>& scratch) {
+    int k = min(options.localSearch, population.size);
+    if (k == 0) return;
+    for (int i = 0; i < population.size; i++) {
+        order[i] = i;
+    }
+    nth_element(order.begin(), order.begin() + (k - 1), order.end(), [&](int a, int b) {
+        return fitness(kp, population, a) > fitness(kp, population, b);
+    });
+
+    auto work = [&](int t) {
+        int parts = pool ? pool->size() : 1;
+        int end = sliceBegin(k, t + 1, parts);
+        for (int e = sliceBegin(k, t, parts); e < end; e++) {
+            localSearch(kp, population, order[e], scratch[t]);
+        }
+    };
+    if (pool) {
+        pool->run(work);
+    }
+    else {
+        work(0);
+    }
+}
+
+double elapsedMs(steady_clock::time_point start) {
+    return duration_cast<chrono::duration<double, milli>>(steady_clock::now() - start).count();
+}
+
+// Mean Jaccard distance between every individual and population[best]:
+// the share of genes that differ among the items either of them takes.
+double diversity(const Instance& kp, const Population& population, int best) {
+    const uint64_t* reference = genesOf(population, best);
+    double total = 0;
+    for (int i = 0; i < population.size; i++) {
+        const uint64_t* genes = genesOf(population, i);
+        int differ = 0, taken = 0;
+        for (int w = 0; w < kp.words; w++) {
+            differ += popcount(genes[w] ^ reference[w]);
+            taken += popcount(genes[w] | reference[w]);
+        }
+        if (taken > 0) {
+            total += (double)differ / taken;
+        }
+    }
+    return total / population.size;
+}
+
+// Returns why a run should stop now, or nullptr to keep going.
+const char* stopReason(const Options& options, int stalledGenerations, double elapsed, double currentDiversity) {
+    if (options.timeMs > 0 && elapsed >= options.timeMs) {
+        return "time budget reached";
+    }
+    if (options.stallGenerations > 0 && stalledGenerations >= options.stallGenerations) {
+        return "no improvement";
+    }
+    if (currentDiversity < options.minDiversity) {
+        return "population converged";
+    }
+    return nullptr;
+}
+
+// Everything a GA run allocates. A batch worker keeps one and reuses it
+// for every instance it solves.
+struct Workspace {
+    Population population, newPopulation;
+    vector<int> fitnessValues;
+    vector<int> order;
+    vector<LocalSearchScratch> scratch;
+};
+
+void prepareWorkspace(const Instance& kp, Workspace& workspace, int populationSize, int workers) {
+    allocatePopulation(workspace.population, populationSize, kp.words, kp.dims);
+    allocatePopulation(workspace.newPopulation, populationSize, kp.words, kp.dims);
+    workspace.fitnessValues.assign(populationSize, 0);
+    workspace.order.assign(populationSize, 0);
+    workspace.scratch.resize(workers);
+    for (auto& buffers : workspace.scratch) {
+        allocateScratch(kp, buffers);
     }
 }
 
-void geneticAlgorithm(int generations, int populationSize) {
-    vector<vector<int>> population;
-    initializePopulation(population, populationSize);
+// Worker t evaluates and breeds its own contiguous slice of pairs using
+// its own Rng, so the result depends only on the seed and thread count.
+// Checkpoints are printed only when report is set.
+int geneticAlgorithm(const Instance& kp, const Options& options, Workspace& workspace, WorkerPool& pool,
+    vector<Rng>& rngs, const ProgressCallback& onProgress, bool report) {
+    auto start = steady_clock::now();
+    int generations = options.generations;
+    int populationSize = options.populationSize;
+    prepareWorkspace(kp, workspace, populationSize, pool.size());
+    Population& population = workspace.population;
+    Population& newPopulation = workspace.newPopulation;
+    vector<int>& fitnessValues = workspace.fitnessValues;
+    vector<int>& order = workspace.order;
+    vector<LocalSearchScratch>& scratch = workspace.scratch;
+    initializePopulation(kp, options, population, pool, rngs);
 
-    vector<int> fitnessValues(populationSize);
     int bestValue = 0;
+    int lastImprovement = 0;
+    int pairs = (populationSize + 1) / 2;
 
     for (int gen = 0; gen <= generations; gen++) {
 
-        for (int i = 0; i < populationSize; i++) {
-            fitnessValues[i] = fitness(population[i]);
-        }
+        pool.run([&](int t) {
+            int end = sliceBegin(populationSize, t + 1, pool.size());
+            for (int i = sliceBegin(populationSize, t, pool.size()); i < end; i++) {
+                fitnessValues[i] = fitness(kp, population, i);
+            }
+        });
 
 
         int currentBest = 0;
-        for (int value : fitnessValues) {
-            if (value > currentBest) {
-                currentBest = value;
+        int bestIdx = 0;
+        for (int i = 0; i < populationSize; i++) {
+            if (fitnessValues[i] > currentBest) {
+                currentBest = fitnessValues[i];
+                bestIdx = i;
+            }
+        }
+        if (currentBest > bestValue) {
+            bestValue = currentBest;
+            lastImprovement = gen;
+            if (onProgress) {
+                onProgress({ gen, elapsedMs(start), bestValue });
             }
         }
-        bestValue = max(bestValue, currentBest);
 
 
-        if (gen == 0 || gen == generations || gen % (generations / 8) == 0) {
+        if (report && (gen == 0 || gen == generations || gen % max(1, generations / 8) == 0)) {
             cout << bestValue << endl;
         }
 
 
+        double currentDiversity = (options.minDiversity > 0) ? diversity(kp, population, bestIdx) : 1.0;
+        const char* reason = stopReason(options, gen - lastImprovement, elapsedMs(start), currentDiversity);
+        if (reason) {
+            if (report) {
+                cerr << "Stopped at generation " << gen << ": " << reason << endl;
+            }
+            break;
+        }
+
+
         bool hasValidIndividual = false;
         for (int i = 0; i < populationSize; i++) {
             if (fitnessValues[i] > 0) {
@@ -107,48 +819,611 @@ void geneticAlgorithm(int generations, int populationSize) {
             }
         }
         if (!hasValidIndividual) {
-            population.clear();
-            initializePopulation(population, populationSize);
+            initializePopulation(kp, options, population, pool, rngs);
             continue;
         }
 
 
-        vector<vector<int>> newPopulation;
-        for (int i = 0; i < populationSize / 2; i++) {
-            vector<int> parent1 = selectParent(population, fitnessValues);
-            vector<int> parent2 = selectParent(population, fitnessValues);
+        pool.run([&](int t) {
+            breedPairs(kp, options, population, fitnessValues, newPopulation,
+                sliceBegin(pairs, t, pool.size()), sliceBegin(pairs, t + 1, pool.size()), rngs[t]);
+        });
+        improveElites(kp, options, newPopulation, order, &pool, scratch);
+        swap(population, newPopulation);
+    }
+
+    return bestValue;
+}
+
+enum MailboxState { MAILBOX_EMPTY, MAILBOX_WRITING, MAILBOX_FULL };
+
+// Single-slot migration mailbox. A sender claims an empty box with a CAS,
+// so any number of islands may target it without a lock; if the box is
+// still full the migrants are dropped instead of blocking the sender.
+struct Mailbox {
+    atomic<int> state{ MAILBOX_EMPTY };
+    Population migrants;
+};
+
+void sendMigrants(Mailbox& box, const Population& population, const vector<int>& order) {
+    int expected = MAILBOX_EMPTY;
+    if (!box.state.compare_exchange_strong(expected, MAILBOX_WRITING, memory_order_acquire)) {
+        return;
+    }
+    for (int i = 0; i < box.migrants.size; i++) {
+        copyIndividual(population, order[i], box.migrants, i);
+    }
+    box.state.store(MAILBOX_FULL, memory_order_release);
+}
+
+// Replaces the worst individuals (the tail of order) with whatever is
+// waiting in the box.
+void receiveMigrants(const Instance& kp, Mailbox& box, Population& population, vector<int>& fitnessValues, const vector<int>& order) {
+    if (box.state.load(memory_order_acquire) != MAILBOX_FULL) {
+        return;
+    }
+    for (int i = 0; i < box.migrants.size; i++) {
+        int idx = order[order.size() - 1 - i];
+        copyIndividual(box.migrants, i, population, idx);
+        fitnessValues[idx] = fitness(kp, population, idx);
+    }
+    box.state.store(MAILBOX_EMPTY, memory_order_release);
+}
+
+void updateBest(atomic<int>& best, int value) {
+    int current = best.load(memory_order_relaxed);
+    while (value > current && !best.compare_exchange_weak(current, value, memory_order_relaxed)) {
+    }
+}
+
+// One island: the usual tournament/crossover/mutation loop on a single
+// thread, exchanging its best individuals every migrationInterval
+// generations. Island 0 reports the best value over all islands.
+void runIsland(const Instance& kp, int id, const Options& options, vector<Mailbox>& mailboxes, atomic<int>& globalBest,
+    atomic<bool>& stop, const ProgressCallback& onProgress, Rng rng) {
+    auto start = steady_clock::now();
+    int generations = options.generations;
+    int populationSize = options.populationSize;
+    int islands = (int)mailboxes.size();
+    Workspace workspace;
+    prepareWorkspace(kp, workspace, populationSize, 1);
+    Population& population = workspace.population;
+    Population& newPopulation = workspace.newPopulation;
+    vector<int>& fitnessValues = workspace.fitnessValues;
+    vector<int>& order = workspace.order;
+    for (int i = 0; i < populationSize; i++) {
+        initializeIndividual(kp, options, population, i, rng);
+    }
+
+    int pairs = (populationSize + 1) / 2;
+    int seenBest = 0;
+    int lastImprovement = 0;
+
+    for (int gen = 0; gen <= generations && !stop.load(memory_order_relaxed); gen++) {
+        for (int i = 0; i < populationSize; i++) {
+            fitnessValues[i] = fitness(kp, population, i);
+        }
+
+        if (gen > 0 && options.migrationInterval > 0 && gen % options.migrationInterval == 0) {
+            for (int i = 0; i < populationSize; i++) {
+                order[i] = i;
+            }
+            sort(order.begin(), order.end(), [&](int a, int b) { return fitnessValues[a] > fitnessValues[b]; });
+
+            int target = options.randomTopology
+                ? (id + 1 + randomInt(rng, 0, islands - 2)) % islands
+                : (id + 1) % islands;
+            sendMigrants(mailboxes[target], population, order);
+            receiveMigrants(kp, mailboxes[id], population, fitnessValues, order);
+        }
 
-            vector<int> child1 = crossover(parent1, parent2);
-            vector<int> child2 = crossover(parent2, parent1);
+        int bestIdx = (int)(max_element(fitnessValues.begin(), fitnessValues.end()) - fitnessValues.begin());
+        int currentBest = fitnessValues[bestIdx];
+        updateBest(globalBest, currentBest);
 
-            mutate(child1);
-            mutate(child2);
+        // Island 0 reports progress and decides when every island stops.
+        if (id == 0) {
+            int best = globalBest.load(memory_order_relaxed);
+            if (best > seenBest) {
+                seenBest = best;
+                lastImprovement = gen;
+                if (onProgress) {
+                    onProgress({ gen, elapsedMs(start), best });
+                }
+            }
+            if (gen == 0 || gen == generations || gen % max(1, generations / 8) == 0) {
+                cout << best << endl;
+            }
 
-            newPopulation.push_back(child1);
-            newPopulation.push_back(child2);
+            double currentDiversity = (options.minDiversity > 0) ? diversity(kp, population, bestIdx) : 1.0;
+            const char* reason = stopReason(options, gen - lastImprovement, elapsedMs(start), currentDiversity);
+            if (reason) {
+                cerr << "Stopped at generation " << gen << ": " << reason << endl;
+                stop.store(true, memory_order_relaxed);
+                break;
+            }
         }
-        population = newPopulation;
+
+        if (currentBest == 0) {
+            for (int i = 0; i < populationSize; i++) {
+                initializeIndividual(kp, options, population, i, rng);
+            }
+            continue;
+        }
+
+        breedPairs(kp, options, population, fitnessValues, newPopulation, 0, pairs, rng);
+        improveElites(kp, options, newPopulation, order, nullptr, workspace.scratch);
+        swap(population, newPopulation);
     }
+}
 
+int islandGeneticAlgorithm(const Instance& kp, const Options& options, const ProgressCallback& onProgress) {
+    vector<Mailbox> mailboxes(options.islands);
+    for (auto& box : mailboxes) {
+        allocatePopulation(box.migrants, min(options.migrants, options.populationSize), kp.words, kp.dims);
+    }
+    atomic<int> globalBest(0);
+    atomic<bool> stop(false);
+    vector<thread> islands;
+    for (int id = 0; id < options.islands; id++) {
+        Rng rng(options.seed * 1000003ULL + id);
+        islands.emplace_back(runIsland, cref(kp), id, cref(options), ref(mailboxes), ref(globalBest),
+            ref(stop), cref(onProgress), rng);
+    }
+    for (auto& island : islands) {
+        island.join();
+    }
 
-    cout << "Best Value: " << bestValue << endl;
+    return globalBest.load();
 }
 
-int main() {
-    srand(time(0));
+// 1-D DP over capacity. The take/skip decision of item i at capacity c
+// is one bit in row i, so the table costs n * (m + 1) bits.
+int dpSolve(const Instance& kp, Chromosome& solution) {
+    int m = kp.capacity[0];
+    int rowWords = m / WORD_BITS + 1;
+    vector<uint64_t> take((size_t)kp.n * rowWords, 0);
+    vector<int> best(m + 1, 0), next(m + 1);
 
-    cin >> m >> n;
-    items.resize(n);
-    for (int i = 0; i < n; i++) {
-        cin >> items[i].weight >> items[i].value;
+    for (int i = 0; i < kp.n; i++) {
+        int weight = kp.itemWeight[i];
+        int value = kp.itemValue[i];
+        if (weight > m) continue;
+        uint64_t* row = &take[(size_t)i * rowWords];
+        for (int c = 0; c < weight; c++) {
+            next[c] = best[c];
+        }
+        for (int c = weight; c <= m; c++) {
+            int with = best[c - weight] + value;
+            uint64_t taken = with > best[c];
+            next[c] = taken ? with : best[c];
+            row[c / WORD_BITS] |= taken << (c % WORD_BITS);
+        }
+        best.swap(next);
     }
 
-    int generations = 1000;
-    int populationSize = 500;
+    solution.assign(kp.words, 0);
+    int c = m;
+    for (int i = kp.n - 1; i >= 0; i--) {
+        if ((take[(size_t)i * rowWords + c / WORD_BITS] >> (c % WORD_BITS)) & 1) {
+            setGene(solution.data(), i);
+            c -= kp.itemWeight[i];
+        }
+    }
+    return best[m];
+}
+
+struct BranchNode {
+    int parent;
+    int item;
+    bool taken;
+};
+
+// Best-first branch and bound over items in ratio order, pruned with the
+// fractional (Dantzig) bound. Returns false if nodeLimit was hit, in
+// which case solution holds the best value found so far.
+bool branchAndBound(const Instance& kp, Chromosome& solution, int& bestValue, long long nodeLimit) {
+    int m = kp.capacity[0];
+    vector<long long> prefixWeight(kp.n + 1, 0), prefixValue(kp.n + 1, 0);
+    for (int k = 0; k < kp.n; k++) {
+        prefixWeight[k + 1] = prefixWeight[k] + kp.itemWeight[kp.ratioOrder[k]];
+        prefixValue[k + 1] = prefixValue[k] + kp.itemValue[kp.ratioOrder[k]];
+    }
+    auto upperBound = [&](int level, int weight, int value) {
+        long long room = (long long)m - weight + prefixWeight[level];
+        int j = (int)(upper_bound(prefixWeight.begin() + level, prefixWeight.end(), room) - prefixWeight.begin()) - 1;
+        double bound = value + (double)(prefixValue[j] - prefixValue[level]);
+        if (j < kp.n) {
+            int item = kp.ratioOrder[j];
+            bound += (double)(room - prefixWeight[j]) * kp.itemValue[item] / kp.itemWeight[item];
+        }
+        return bound;
+    };
+
+    struct Open {
+        double bound;
+        int level, weight, value, node;
+        bool operator<(const Open& other) const { return bound < other.bound; }
+    };
+
+    solution = greedySolution(kp);
+    int unused[MAX_DIMS] = {};
+    bestValue = 0;
+    addSegment(kp, solution.data(), 0, kp.n, unused, bestValue);
+
+    vector<BranchNode> nodes;
+    priority_queue<Open> open;
+    open.push({ upperBound(0, 0, 0), 0, 0, 0, -1 });
+    int bestNode = -2;
+
+    while (!open.empty()) {
+        Open cur = open.top();
+        open.pop();
+        if ((int)cur.bound <= bestValue) break;
+        if (cur.level == kp.n) continue;
+        if ((long long)nodes.size() >= nodeLimit) {
+            open.push(cur);
+            break;
+        }
+
+        int item = kp.ratioOrder[cur.level];
+        int weight = cur.weight + kp.itemWeight[item];
+        int value = cur.value + kp.itemValue[item];
+        if (weight <= m) {
+            nodes.push_back({ cur.node, item, true });
+            int node = (int)nodes.size() - 1;
+            if (value > bestValue) {
+                bestValue = value;
+                bestNode = node;
+            }
+            double bound = upperBound(cur.level + 1, weight, value);
+            if ((int)bound > bestValue) {
+                open.push({ bound, cur.level + 1, weight, value, node });
+            }
+        }
+        double bound = upperBound(cur.level + 1, cur.weight, cur.value);
+        if ((int)bound > bestValue) {
+            nodes.push_back({ cur.node, item, false });
+            open.push({ bound, cur.level + 1, cur.weight, cur.value, (int)nodes.size() - 1 });
+        }
+    }
+
+    if (bestNode != -2) {
+        solution.assign(kp.words, 0);
+        for (int node = bestNode; node != -1; node = nodes[node].parent) {
+            if (nodes[node].taken) {
+                setGene(solution.data(), nodes[node].item);
+            }
+        }
+    }
+    return open.empty() || (int)open.top().bound <= bestValue;
+}
+
+// The DP runs n * (m + 1) cell updates; past this many branch and bound
+// is the better bet however little memory the table takes.
+const double DP_WORK_LIMIT = 4e9;
+
+// Counts the decision bits and the two int rows dpSolve() keeps.
+bool dpTableFits(const Instance& kp, const Options& options) {
+    double cells = (double)kp.n * (kp.capacity[0] + 1);
+    double bytes = cells / 8 + 2.0 * sizeof(int) * (kp.capacity[0] + 1);
+    return bytes / (1 << 20) <= options.dpLimitMb && cells <= DP_WORK_LIMIT;
+}
+
+// Single-constraint instances only. Picks the DP when its memory fits
+// in dpLimitMb and its work is bounded, otherwise branch and bound.
+// proven is false if the node limit cut the search.
+int exactSolve(const Instance& kp, const Options& options, Chromosome& solution, bool& proven) {
+    int bestValue;
+    proven = true;
+    if (dpTableFits(kp, options)) {
+        bestValue = dpSolve(kp, solution);
+    }
+    else {
+        proven = branchAndBound(kp, solution, bestValue, options.nodeLimit);
+    }
+    return bestValue;
+}
+
+// Reads "c_1 ... c_d n" followed by n lines "w_1 ... w_d v". With d = 1
+// this is the usual "m n" format.
+bool readInstance(istream& in, Instance& kp, int dims) {
+    kp.dims = dims;
+    kp.capacity.resize(dims);
+    for (int k = 0; k < dims; k++) {
+        if (!(in >> kp.capacity[k])) {
+            return false;
+        }
+    }
+    if (!(in >> kp.n) || kp.n < 0) {
+        return false;
+    }
+    kp.weightRows.resize((size_t)kp.n * dims);
+    kp.itemValue.resize(kp.n);
+    for (int i = 0; i < kp.n; i++) {
+        for (int k = 0; k < dims; k++) {
+            if (!(in >> kp.weightRows[(size_t)i * dims + k])) {
+                return false;
+            }
+        }
+        if (!(in >> kp.itemValue[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void prepareInstance(Instance& kp, const Options& options) {
+    buildItemColumns(kp);
+    buildRatioOrder(kp);
+    kp.greedySeed.clear();
+    if (options.seedGreedy) {
+        kp.greedySeed = greedySolution(kp);
+    }
+}
+
+// Reads instances from in and solves them on options.threads workers.
+// The reader hands instances over through a bounded queue. Each worker
+// keeps its Workspace across instances and prints every result as soon
+// as it is done, tagged with the instance's position in the stream.
+// A malformed or truncated instance stops the reading: the instances
+// before it are still solved, but false is returned.
+bool batchSolve(istream& in, const Options& options) {
+    const size_t capacity = 4 * (size_t)options.threads;
+    deque<Instance> pending;
+    bool finished = false;
+    mutex queueMutex, outputMutex;
+    condition_variable notEmpty, notFull;
+    atomic<int> solved(0);
+
+    auto worker = [&]() {
+        Workspace workspace;
+        WorkerPool serial(1);
+        vector<Rng> rngs(1);
+        Chromosome solution;
+        Instance kp;
+        while (true) {
+            {
+                unique_lock<mutex> lock(queueMutex);
+                notEmpty.wait(lock, [&]() { return finished || !pending.empty(); });
+                if (pending.empty()) return;
+                kp = move(pending.front());
+                pending.pop_front();
+            }
+            notFull.notify_one();
+
+            prepareInstance(kp, options);
+            int bestValue;
+            bool proven = true;
+            if (options.exact) {
+                bestValue = exactSolve(kp, options, solution, proven);
+            }
+            else {
+                rngs[0] = Rng(options.seed * 1000003ULL + kp.id);
+                bestValue = geneticAlgorithm(kp, options, workspace, serial, rngs, nullptr, false);
+            }
+            solved++;
+
+            lock_guard<mutex> lock(outputMutex);
+            cout << "Instance " << kp.id << ": " << bestValue << (proven ? "" : " (not proven)") << '\n';
+        }
+    };
+
+    auto start = steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < options.threads; t++) {
+        workers.emplace_back(worker);
+    }
+
+    Instance kp;
+    bool valid = true;
+    for (int id = 0; !(in >> ws).eof(); id++) {
+        if (!readInstance(in, kp, options.dims)) {
+            cerr << "Invalid instance " << id << " in the batch" << endl;
+            valid = false;
+            break;
+        }
+        kp.id = id;
+        unique_lock<mutex> lock(queueMutex);
+        notFull.wait(lock, [&]() { return pending.size() < capacity; });
+        pending.push_back(move(kp));
+        lock.unlock();
+        notEmpty.notify_one();
+    }
+    {
+        lock_guard<mutex> lock(queueMutex);
+        finished = true;
+    }
+    notEmpty.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+    cout.flush();
+
+    double seconds = elapsedMs(start) / 1000;
+    cerr << "Solved " << solved.load() << " instances in " << fixed << seconds << " seconds ("
+        << (seconds > 0 ? solved.load() / seconds : 0.0) << " instances/sec)" << endl;
+    return valid;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    bool hasGenerations = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--exact") {
+            options.exact = true;
+            continue;
+        }
+        if (arg == "--seed-greedy") {
+            options.seedGreedy = true;
+            continue;
+        }
+        if (arg == "--repair") {
+            options.repair = true;
+            continue;
+        }
+        if (arg == "--ratio-init") {
+            options.ratioInit = true;
+            continue;
+        }
+        if (arg == "--progress") {
+            options.progress = true;
+            continue;
+        }
+        if (arg == "--batch") {
+            options.batch = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        if (arg == "--generations") {
+            options.generations = max(0, atoi(argv[++i]));
+            hasGenerations = true;
+        }
+        else if (arg == "--population") {
+            options.populationSize = max(2, atoi(argv[++i]));
+        }
+        else if (arg == "--time-ms") {
+            options.timeMs = max(0LL, atoll(argv[++i]));
+        }
+        else if (arg == "--stall") {
+            options.stallGenerations = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--min-diversity") {
+            options.minDiversity = atof(argv[++i]);
+        }
+        else if (arg == "--input") {
+            options.input = argv[++i];
+        }
+        else if (arg == "--dims") {
+            options.dims = atoi(argv[++i]);
+            if (options.dims < 1 || options.dims > MAX_DIMS) {
+                cerr << "--dims must be between 1 and " << MAX_DIMS << endl;
+                return false;
+            }
+        }
+        else if (arg == "--threads") {
+            options.threads = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--seed") {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+            options.hasSeed = true;
+        }
+        else if (arg == "--islands") {
+            options.islands = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--migration-interval") {
+            options.migrationInterval = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--migrants") {
+            options.migrants = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--topology") {
+            string topology = argv[++i];
+            if (topology != "ring" && topology != "random") {
+                cerr << "Unknown topology " << topology << endl;
+                return false;
+            }
+            options.randomTopology = (topology == "random");
+        }
+        else if (arg == "--local-search") {
+            options.localSearch = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--dp-limit-mb") {
+            options.dpLimitMb = max(0LL, atoll(argv[++i]));
+        }
+        else if (arg == "--node-limit") {
+            options.nodeLimit = max(1LL, atoll(argv[++i]));
+        }
+        else {
+            cerr << "Unknown option " << arg << endl;
+            return false;
+        }
+    }
+    // A time budget without a generation count runs until the budget.
+    if (options.timeMs > 0 && !hasGenerations) {
+        options.generations = INT_MAX - 1;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (!options.hasSeed) {
+        options.seed = (uint64_t)time(0);
+    }
+    if (options.exact && options.dims > 1) {
+        cerr << "--exact supports single-constraint instances only" << endl;
+        return 1;
+    }
+
+    ifstream file;
+    if (!options.input.empty()) {
+        file.open(options.input);
+        if (!file) {
+            cerr << "Cannot open " << options.input << endl;
+            return 1;
+        }
+    }
+    istream& in = options.input.empty() ? cin : file;
+
+    if (options.batch) {
+        return batchSolve(in, options) ? 0 : 1;
+    }
+
+    Instance kp;
+    if (!readInstance(in, kp, options.dims)) {
+        cerr << "Invalid input" << endl;
+        return 1;
+    }
+    prepareInstance(kp, options);
+
+    ProgressCallback onProgress;
+    if (options.progress) {
+        onProgress = [](const Progress& progress) {
+            cerr << "Progress: generation " << progress.generation << ", " << fixed << progress.elapsedMs
+                << " ms, best " << progress.bestValue << endl;
+        };
+    }
 
     auto start = high_resolution_clock::now();
     cout << '\n';
-    geneticAlgorithm(generations, populationSize);
+    if (options.exact) {
+        Chromosome solution;
+        bool proven;
+        int bestValue = exactSolve(kp, options, solution, proven);
+        cerr << "Method: " << (dpTableFits(kp, options) ? "dynamic programming" : "branch and bound") << endl;
+        if (!proven) {
+            cerr << "Node limit reached, the value is not proven optimal" << endl;
+        }
+        cout << "Best Value: " << bestValue << endl;
+        cout << "Items:";
+        for (int i = 0; i < kp.n; i++) {
+            if (getGene(solution.data(), i)) {
+                cout << ' ' << i;
+            }
+        }
+        cout << endl;
+    }
+    else if (options.islands > 1) {
+        int bestValue = islandGeneticAlgorithm(kp, options, onProgress);
+        cout << "Best Value: " << bestValue << endl;
+    }
+    else {
+        WorkerPool pool(options.threads);
+        vector<Rng> rngs;
+        for (int t = 0; t < pool.size(); t++) {
+            rngs.push_back(Rng(options.seed * 1000003ULL + t));
+        }
+        Workspace workspace;
+        int bestValue = geneticAlgorithm(kp, options, workspace, pool, rngs, onProgress, true);
+        cout << "Best Value: " << bestValue << endl;
+    }
     auto end = high_resolution_clock::now();
 
     double duration = duration_cast<chrono::duration<double>>(end - start).count();
@@ -156,4 +1431,3 @@ int main() {
 
     return 0;
 }
-
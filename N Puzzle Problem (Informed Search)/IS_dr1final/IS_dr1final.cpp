@@ -8,21 +8,321 @@
 #include <sstream>
 #include <chrono>
 #include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <bit>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 using namespace chrono;
 
 
-const vector<int> DIR_ROW = { 0, 0, -1, 1 };
-const vector<int> DIR_COL = { -1, 1, 0, 0 };
+constexpr int DIR_ROW[4] = { 0, 0, -1, 1 };
+constexpr int DIR_COL[4] = { -1, 1, 0, 0 };
 const vector<string> DIR_NAME = { "right", "left", "down", "up" };
 
 
 vector<int> goalState;
 vector<int> goalPos;
 int dim;
-vector<string> finalPath;
-bool foundSolution = false;
+int threads = 1;
+
+
+const int MAX_CELLS = 32;
+const int MAX_DIM = 5;
+int goalBlank;
+// zobristKey[t][p] is XORed into a board's hash while tile t is on p.
+uint64_t zobristKey[MAX_CELLS][MAX_CELLS];
+
+// Transposition table: one word per slot holding the top 40 bits of a
+// board's Zobrist hash, the smallest g it was reached at and the stamp
+// of the threshold iteration that wrote it. Slots are probed in pairs.
+struct TranspositionTable {
+    vector<atomic<uint64_t>> slots;
+    size_t mask = 0;
+    uint16_t stamp = 0;
+};
+
+// Set by --tt-mb; -1 sizes the table by board dimension.
+int transpositionMb = -1;
+
+// Node counters, compiled in with -DSEARCH_STATS. Each thread counts
+// into its own copy and folds it into the iteration's totals when its
+// share of the iteration is done. Without the flag COUNT_NODE expands
+// to nothing and the search carries no extra code.
+#ifdef SEARCH_STATS
+struct NodeCounters {
+    uint64_t expanded = 0;
+    uint64_t generated = 0;
+    uint64_t pruned = 0;
+    uint64_t transposed = 0;
+    uint64_t heuristicNanos = 0;
+};
+
+struct IterationStats {
+    int threshold;
+    NodeCounters nodes;
+    double seconds = 0;
+    steady_clock::time_point start;
+};
+
+thread_local NodeCounters nodeCounters;
+#define COUNT_NODE(field) (nodeCounters.field++)
+
+// Times one heuristic evaluation in HEURISTIC_SAMPLE, to the end of
+// the scope, and counts it for all of them: reading the clock on every
+// node would cost more than most heuristics.
+const uint32_t HEURISTIC_SAMPLE = 64;
+thread_local uint32_t heuristicCalls = 0;
+
+struct HeuristicTimer {
+    bool sampled = ++heuristicCalls % HEURISTIC_SAMPLE == 0;
+    steady_clock::time_point start = sampled ? steady_clock::now() : steady_clock::time_point();
+    ~HeuristicTimer() {
+        if (sampled) {
+            nodeCounters.heuristicNanos += HEURISTIC_SAMPLE * duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        }
+    }
+};
+#define TIME_HEURISTIC() HeuristicTimer heuristicTimer
+#else
+#define COUNT_NODE(field) ((void)0)
+#define TIME_HEURISTIC() ((void)0)
+#endif
+
+// Everything the search of one board writes. done is set by the first
+// thread to reach the goal; every other one sees it and unwinds.
+struct Search {
+    // Moves are indices into DIR_NAME; names are only rendered for output.
+    vector<uint8_t> solution;
+    bool found = false;
+    atomic<bool> done{ false };
+    TranspositionTable table;
+#ifdef SEARCH_STATS
+    vector<IterationStats> iterations;
+    mutex statsLock;
+#endif
+};
+
+
+enum Heuristic { MANHATTAN, LINEAR_CONFLICT, WALKING_DISTANCE, PATTERN_DATABASE };
+Heuristic heuristic = MANHATTAN;
+string pdbDir = ".";
+
+// Pattern databases partition the tiles by goal cell; the blank's goal
+// cell is dropped from its group. The patterns are disjoint, so their
+// values add up to an admissible estimate that dominates Manhattan.
+const vector<vector<int>> PATTERN_CELLS_3 = { {0, 1, 2, 3, 4}, {5, 6, 7, 8} };
+const vector<vector<int>> PATTERN_CELLS_4 = { {0, 4, 5, 8, 9, 12}, {6, 7, 10, 11, 13, 14}, {1, 2, 3, 15} };
+const vector<vector<int>> PATTERN_CELLS_5 = { {0, 1, 2, 5, 6}, {3, 4, 7, 8, 9}, {10, 11, 15, 20, 21},
+    {12, 13, 14, 18, 19}, {16, 17, 22, 23, 24} };
+const uint8_t UNSEEN = 255;
+
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// On-disk layout: this header followed by one distance byte per
+// placement of the pattern's tiles, in rankPattern() order.
+struct PdbHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t goalBlank;
+    uint32_t tileCount;
+    uint32_t reserved;
+    uint64_t entries;
+    uint8_t tiles[32];
+};
+
+struct PatternDatabase {
+    vector<int> tiles;
+    size_t entries = 0;
+    const uint8_t* table = nullptr;
+    MappedFile file;
+    vector<uint8_t> owned;
+};
+
+vector<PatternDatabase> patterns;
+vector<int> patternOf;
+
+// Exact distance of every solvable 3x3 board, two per byte: the low
+// nibble holds the even index. A nibble is the distance mod 15, which
+// is enough to walk downhill since neighbours differ by exactly 1, or
+// 15 for a board the BFS never reached. The index is rankPattern() of
+// the tiles' cells halved: the order of the last two tiles is fixed by
+// the board's parity.
+const size_t FULL_TABLE_ENTRIES = 181440;
+const uint8_t FULL_UNREACHED = 15;
+
+struct FullTable {
+    const uint8_t* table = nullptr;
+    MappedFile file;
+    vector<uint8_t> owned;
+};
+
+FullTable fullTable;
+bool useFullTable = false;
+
+// Walking distance along one axis: counts[r][g] is the number of tiles
+// in line r whose goal is in line g. A move along the axis shifts one
+// tile between the blank's line and a neighbouring one, so the BFS
+// distance over these counts bounds the moves along that axis.
+// next[(state * 2 + side) * dim + g] is the state after a tile of class
+// g enters the blank's line from the line before (side 0) or after it
+// (side 1), or -1. Only boards up to WALK_MAX_DIM are covered: the 5x5
+// count matrices run into the tens of millions and the BFS does not
+// finish in reasonable time, so larger boards use linear conflict.
+const int WALK_MAX_DIM = 4;
+
+struct WalkTable {
+    vector<uint8_t> dist;
+    vector<int> next;
+    unordered_map<uint64_t, int> index;
+};
+
+WalkTable walkRows, walkCols;
+
+
+// Cell geometry of a D x D board, computed at compile time so the
+// search never divides by D or bounds-checks a move.
+template <int D>
+struct Geometry {
+    static constexpr int CELLS = D * D;
+    // neighbor[p][i] is the cell the blank reaches from p with move i,
+    // or -1 if that move leaves the board.
+    int8_t neighbor[CELLS][4];
+    int8_t row[CELLS];
+    int8_t col[CELLS];
+    // distance[a][b] is the Manhattan distance between cells a and b.
+    int8_t distance[CELLS][CELLS];
+    // goalCell[b][t] is tile t's goal cell when the blank's goal is b.
+    int8_t goalCell[CELLS][CELLS];
+
+    constexpr Geometry() : neighbor(), row(), col(), distance(), goalCell() {
+        for (int p = 0; p < CELLS; p++) {
+            row[p] = (int8_t)(p / D);
+            col[p] = (int8_t)(p % D);
+        }
+        for (int p = 0; p < CELLS; p++) {
+            for (int i = 0; i < 4; i++) {
+                int r = row[p] + DIR_ROW[i];
+                int c = col[p] + DIR_COL[i];
+                neighbor[p][i] = (int8_t)((r < 0 || r >= D || c < 0 || c >= D) ? -1 : r * D + c);
+            }
+            for (int q = 0; q < CELLS; q++) {
+                int dr = row[p] - row[q];
+                int dc = col[p] - col[q];
+                distance[p][q] = (int8_t)((dr < 0 ? -dr : dr) + (dc < 0 ? -dc : dc));
+            }
+        }
+        for (int b = 0; b < CELLS; b++) {
+            for (int t = 1; t < CELLS; t++) {
+                goalCell[b][t] = (int8_t)(t - 1 < b ? t - 1 : t);
+            }
+        }
+    }
+};
+
+template <int D>
+constexpr Geometry<D> GEOMETRY{};
+
+
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 Word128;
+#else
+// The few 128-bit operations the search needs, for compilers without a
+// native 128-bit integer.
+struct Word128 {
+    uint64_t lo = 0, hi = 0;
+
+    Word128() = default;
+    Word128(uint64_t value) : lo(value) {}
+    explicit operator uint64_t() const { return lo; }
+
+    friend Word128 operator<<(Word128 a, int s) {
+        Word128 r;
+        if (s >= 64) {
+            r.hi = a.lo << (s - 64);
+        }
+        else if (s > 0) {
+            r.hi = (a.hi << s) | (a.lo >> (64 - s));
+            r.lo = a.lo << s;
+        }
+        else {
+            r = a;
+        }
+        return r;
+    }
+    friend Word128 operator>>(Word128 a, int s) {
+        Word128 r;
+        if (s >= 64) {
+            r.lo = a.hi >> (s - 64);
+        }
+        else if (s > 0) {
+            r.lo = (a.lo >> s) | (a.hi << (64 - s));
+            r.hi = a.hi >> s;
+        }
+        else {
+            r = a;
+        }
+        return r;
+    }
+    friend Word128 operator&(Word128 a, Word128 b) {
+        a.lo &= b.lo;
+        a.hi &= b.hi;
+        return a;
+    }
+    friend Word128 operator|(Word128 a, Word128 b) {
+        a.lo |= b.lo;
+        a.hi |= b.hi;
+        return a;
+    }
+    friend Word128 operator+(Word128 a, Word128 b) {
+        Word128 r;
+        r.lo = a.lo + b.lo;
+        r.hi = a.hi + b.hi + (r.lo < a.lo);
+        return r;
+    }
+    friend Word128 operator-(Word128 a, Word128 b) {
+        Word128 r;
+        r.lo = a.lo - b.lo;
+        r.hi = a.hi - b.hi - (a.lo < b.lo);
+        return r;
+    }
+    friend bool operator==(Word128 a, Word128 b) { return a.lo == b.lo && a.hi == b.hi; }
+};
+#endif
+
+// Boards are packed one cell per field: 4 bits in a uint64_t up to 4x4,
+// 5 bits in 128 bits for 5x5. A second word of the same shape holds the
+// inverse, the cell of every tile.
+template <int D>
+using BoardWord = conditional_t<(D <= 4), uint64_t, Word128>;
+
+template <int D>
+constexpr int CELL_BITS = D <= 4 ? 4 : 5;
+
+template <int D>
+BoardWord<D> goalBoard;
 
 
 vector<int> buildGoalState(int N, int zeroIndex) {
@@ -56,11 +356,6 @@ vector<int> buildGoalPos(const vector<int>& goal) {
 }
 
 
-bool isGoal(const vector<int>& board) {
-    return (board == goalState);
-}
-
-
 int manhattanDistance(const vector<int>& board) {
     int dist = 0;
     int sz = (int)board.size();
@@ -76,70 +371,1023 @@ int manhattanDistance(const vector<int>& board) {
 }
 
 
-string encode(const vector<int>& board) {
+bool mapFile(const string& path, MappedFile& mapped) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) return false;
+    mapped.data = (const uint8_t*)view;
+    mapped.size = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    mapped.data = (const uint8_t*)view;
+    mapped.size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+
+void unmapFile(MappedFile& mapped) {
+    if (mapped.data == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped.data);
+#else
+    munmap((void*)mapped.data, mapped.size);
+#endif
+    mapped = MappedFile();
+}
+
+
+size_t countPlacements(int cells, int k) {
+    size_t count = 1;
+    for (int i = 0; i < k; i++) {
+        count *= cells - i;
+    }
+    return count;
+}
+
+
+int nthFreeCell(uint32_t used, int n) {
+    for (int c = 0; ; c++) {
+        if (!((used >> c) & 1) && n-- == 0) return c;
+    }
+}
+
+
+// Ranks k distinct cells as a partial permutation: each cell contributes
+// its index among the cells not taken by the earlier ones.
+size_t rankPattern(const int* cellOf, int k, int cells) {
+    size_t rank = 0;
+    uint32_t used = 0;
+    for (int i = 0; i < k; i++) {
+        int digit = cellOf[i] - popcount(used & ((1u << cellOf[i]) - 1));
+        rank = rank * (cells - i) + digit;
+        used |= 1u << cellOf[i];
+    }
+    return rank;
+}
+
+
+uint32_t unrankPattern(size_t rank, int k, int cells, int* cellOf) {
+    int digits[MAX_CELLS];
+    for (int i = k - 1; i >= 0; i--) {
+        digits[i] = (int)(rank % (cells - i));
+        rank /= cells - i;
+    }
+    uint32_t used = 0;
+    for (int i = 0; i < k; i++) {
+        cellOf[i] = nthFreeCell(used, digits[i]);
+        used |= 1u << cellOf[i];
+    }
+    return used;
+}
+
+
+template <class Job>
+void parallelFor(int threads, Job job) {
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back(job, t);
+    }
+    job(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+
+// Backward 0-1 BFS from the goal over (pattern tile cells, blank cell).
+// Sliding a pattern tile costs 1 and any other tile 0, so only pattern
+// moves are counted and the databases stay additive. Each level is
+// closed under zero-cost moves before the next starts; every pass is
+// split over the threads, which claim a state by lowering its distance
+// with a CAS. The table keeps the minimum over the blank's cells.
+vector<uint8_t> buildPatternTable(const vector<int>& tiles, int threads) {
+    int cells = dim * dim;
+    int k = (int)tiles.size();
+    int freeCells = cells - k;
+    size_t placements = countPlacements(cells, k);
+    vector<atomic<uint8_t>> dist(placements * freeCells);
+    for (auto& d : dist) {
+        d.store(UNSEEN, memory_order_relaxed);
+    }
+
+    auto stateIndex = [&](size_t rank, uint32_t used, int blank) {
+        return rank * freeCells + blank - popcount(used & ((1u << blank) - 1));
+    };
+    auto lower = [&](size_t idx, int level) {
+        uint8_t cur = dist[idx].load(memory_order_relaxed);
+        while (cur > level) {
+            if (dist[idx].compare_exchange_weak(cur, (uint8_t)level, memory_order_relaxed)) return true;
+        }
+        return false;
+    };
+
+    int cellOf[MAX_CELLS];
+    uint32_t used = 0;
+    for (int i = 0; i < k; i++) {
+        cellOf[i] = goalPos[tiles[i]];
+        used |= 1u << cellOf[i];
+    }
+    int goalBlank = (int)(find(goalState.begin(), goalState.end(), 0) - goalState.begin());
+    size_t goal = stateIndex(rankPattern(cellOf, k, cells), used, goalBlank);
+    dist[goal].store(0);
+
+    vector<uint32_t> current = { (uint32_t)goal };
+    vector<vector<uint32_t>> same(threads), next(threads);
+    for (int level = 0; !current.empty(); level++) {
+        vector<uint32_t> pass;
+        pass.swap(current);
+        while (!pass.empty()) {
+            parallelFor(threads, [&](int t) {
+                size_t from = pass.size() * t / threads;
+                size_t to = pass.size() * (t + 1) / threads;
+                int cellOf[MAX_CELLS];
+                for (size_t p = from; p < to; p++) {
+                    size_t state = pass[p];
+                    if (dist[state].load(memory_order_relaxed) != level) continue;
+                    size_t rank = state / freeCells;
+                    uint32_t used = unrankPattern(rank, k, cells, cellOf);
+                    int blank = nthFreeCell(used, (int)(state % freeCells));
+                    int r = blank / dim, c = blank % dim;
+                    for (int i = 0; i < 4; i++) {
+                        int rr = r + DIR_ROW[i];
+                        int cc = c + DIR_COL[i];
+                        if (rr < 0 || rr >= dim || cc < 0 || cc >= dim) continue;
+                        int q = rr * dim + cc;
+                        if (!((used >> q) & 1)) {
+                            size_t idx = stateIndex(rank, used, q);
+                            if (lower(idx, level)) same[t].push_back((uint32_t)idx);
+                            continue;
+                        }
+                        int j = 0;
+                        while (cellOf[j] != q) j++;
+                        cellOf[j] = blank;
+                        uint32_t moved = used ^ (1u << q) ^ (1u << blank);
+                        size_t idx = stateIndex(rankPattern(cellOf, k, cells), moved, q);
+                        cellOf[j] = q;
+                        if (lower(idx, level + 1)) next[t].push_back((uint32_t)idx);
+                    }
+                }
+            });
+            pass.clear();
+            for (auto& part : same) {
+                pass.insert(pass.end(), part.begin(), part.end());
+                part.clear();
+            }
+        }
+        for (auto& part : next) {
+            current.insert(current.end(), part.begin(), part.end());
+            part.clear();
+        }
+    }
+
+    vector<uint8_t> table(placements);
+    for (size_t rank = 0; rank < placements; rank++) {
+        uint8_t best = UNSEEN;
+        for (int b = 0; b < freeCells; b++) {
+            best = min(best, dist[rank * freeCells + b].load(memory_order_relaxed));
+        }
+        table[rank] = best;
+    }
+    return table;
+}
+
+
+PdbHeader makePdbHeader(const PatternDatabase& pdb) {
+    PdbHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "NPDB", 4);
+    header.version = 1;
+    header.dim = dim;
+    header.goalBlank = (uint32_t)(find(goalState.begin(), goalState.end(), 0) - goalState.begin());
+    header.tileCount = (uint32_t)pdb.tiles.size();
+    header.entries = pdb.entries;
+    for (int i = 0; i < (int)pdb.tiles.size(); i++) {
+        header.tiles[i] = (uint8_t)pdb.tiles[i];
+    }
+    return header;
+}
+
+
+string pdbPath(const PatternDatabase& pdb) {
+    PdbHeader header = makePdbHeader(pdb);
     ostringstream oss;
-    for (int i = 0; i < (int)board.size(); i++) {
-        oss << board[i] << ',';
+    oss << pdbDir << "/pdb_" << dim << "x" << dim << "_b" << header.goalBlank;
+    for (int i = 0; i < (int)pdb.tiles.size(); i++) {
+        oss << (i == 0 ? "_" : "-") << pdb.tiles[i];
     }
+    oss << ".bin";
     return oss.str();
 }
 
-bool dfs(vector<int>& board, int g, int threshold, int& minNextThreshold,
-    vector<string>& path, int lastMove) {
-    int h = manhattanDistance(board);
-    int f = g + h;
-    if (f > threshold) {
-        minNextThreshold = min(minNextThreshold, f);
+
+bool loadPatternDatabase(PatternDatabase& pdb, const string& path) {
+    MappedFile file;
+    if (!mapFile(path, file)) return false;
+    PdbHeader expected = makePdbHeader(pdb);
+    if (file.size != sizeof(PdbHeader) + pdb.entries || memcmp(file.data, &expected, sizeof(PdbHeader)) != 0) {
+        cerr << "Ignoring stale pattern database " << path << endl;
+        unmapFile(file);
         return false;
     }
-    if (isGoal(board)) {
-        finalPath = path;
-        foundSolution = true;
-        return true;
+    pdb.file = file;
+    pdb.table = file.data + sizeof(PdbHeader);
+    return true;
+}
+
+
+// Unmaps the tables of the previous goal; the search must be done with
+// them.
+void releasePatternDatabases() {
+    for (auto& pdb : patterns) {
+        unmapFile(pdb.file);
+    }
+    patterns.clear();
+}
+
+
+// Maps each pattern's table from pdbDir, building and saving the ones
+// that are missing. If a table can't be saved it is kept in memory.
+bool preparePatternDatabases() {
+    releasePatternDatabases();
+    const vector<vector<int>>* groups = dim == 3 ? &PATTERN_CELLS_3
+        : dim == 4 ? &PATTERN_CELLS_4
+        : dim == 5 ? &PATTERN_CELLS_5 : nullptr;
+    if (groups == nullptr) return false;
+
+    int threads = max(1, (int)thread::hardware_concurrency());
+    patterns.assign(groups->size(), PatternDatabase());
+    patternOf.assign(dim * dim, -1);
+    for (int j = 0; j < (int)groups->size(); j++) {
+        PatternDatabase& pdb = patterns[j];
+        for (int cell : (*groups)[j]) {
+            if (goalState[cell] != 0) {
+                pdb.tiles.push_back(goalState[cell]);
+                patternOf[goalState[cell]] = j;
+            }
+        }
+        pdb.entries = countPlacements(dim * dim, (int)pdb.tiles.size());
+
+        string path = pdbPath(pdb);
+        if (loadPatternDatabase(pdb, path)) continue;
+
+        cerr << "Building pattern database " << path << endl;
+        pdb.owned = buildPatternTable(pdb.tiles, threads);
+        PdbHeader header = makePdbHeader(pdb);
+        ofstream out(path, ios::binary);
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)pdb.owned.data(), pdb.owned.size());
+        out.close();
+        if (out && loadPatternDatabase(pdb, path)) {
+            vector<uint8_t>().swap(pdb.owned);
+        }
+        else {
+            cerr << "Cannot save " << path << ", keeping it in memory" << endl;
+            pdb.table = pdb.owned.data();
+        }
+    }
+    return true;
+}
+
+
+int patternHeuristic(const vector<int>& board) {
+    int cellOfTile[MAX_CELLS];
+    for (int i = 0; i < (int)board.size(); i++) {
+        cellOfTile[board[i]] = i;
+    }
+    int h = 0;
+    for (const auto& pdb : patterns) {
+        int cellOf[MAX_CELLS];
+        for (int i = 0; i < (int)pdb.tiles.size(); i++) {
+            cellOf[i] = cellOfTile[pdb.tiles[i]];
+        }
+        h += pdb.table[rankPattern(cellOf, (int)pdb.tiles.size(), dim * dim)];
+    }
+    return h;
+}
+
+
+size_t fullTableIndex(const int* cellOf) {
+    return rankPattern(cellOf, 9, 9) / 2;
+}
+
+
+int fullTableValue(const uint8_t* table, size_t index) {
+    return (table[index / 2] >> (index % 2 * 4)) & 15;
+}
+
+
+// Level-synchronous BFS from the goal over whole boards. Each level is
+// split over the threads, which claim a board with a CAS on its
+// distance; the frontier keeps full ranks so boards unrank directly.
+vector<uint8_t> buildFullTable(int threads) {
+    vector<atomic<uint8_t>> dist(FULL_TABLE_ENTRIES);
+    for (auto& d : dist) {
+        d.store(UNSEEN, memory_order_relaxed);
+    }
+
+    int cellOf[MAX_CELLS];
+    for (int t = 0; t < 9; t++) {
+        cellOf[t] = t == 0 ? goalBlank : goalPos[t];
+    }
+    uint32_t goal = (uint32_t)rankPattern(cellOf, 9, 9);
+    dist[goal / 2].store(0);
+
+    vector<uint32_t> current = { goal };
+    vector<vector<uint32_t>> next(threads);
+    for (int level = 0; !current.empty(); level++) {
+        parallelFor(threads, [&](int t) {
+            size_t from = current.size() * t / threads;
+            size_t to = current.size() * (t + 1) / threads;
+            int cellOf[MAX_CELLS];
+            for (size_t p = from; p < to; p++) {
+                unrankPattern(current[p], 9, 9, cellOf);
+                int blank = cellOf[0];
+                int r = blank / 3, c = blank % 3;
+                for (int i = 0; i < 4; i++) {
+                    int rr = r + DIR_ROW[i];
+                    int cc = c + DIR_COL[i];
+                    if (rr < 0 || rr >= 3 || cc < 0 || cc >= 3) continue;
+                    int q = rr * 3 + cc;
+                    int j = 1;
+                    while (cellOf[j] != q) j++;
+                    cellOf[0] = q;
+                    cellOf[j] = blank;
+                    uint32_t rank = (uint32_t)rankPattern(cellOf, 9, 9);
+                    cellOf[0] = blank;
+                    cellOf[j] = q;
+                    uint8_t unseen = UNSEEN;
+                    if (dist[rank / 2].compare_exchange_strong(unseen, (uint8_t)(level + 1), memory_order_relaxed)) {
+                        next[t].push_back(rank);
+                    }
+                }
+            }
+        });
+        current.clear();
+        for (auto& part : next) {
+            current.insert(current.end(), part.begin(), part.end());
+            part.clear();
+        }
+    }
+
+    vector<uint8_t> table(FULL_TABLE_ENTRIES / 2);
+    for (size_t index = 0; index < FULL_TABLE_ENTRIES; index++) {
+        uint8_t d = dist[index].load(memory_order_relaxed);
+        uint8_t nibble = d == UNSEEN ? FULL_UNREACHED : d % 15;
+        table[index / 2] |= nibble << (index % 2 * 4);
+    }
+    return table;
+}
+
+
+PdbHeader makeFullTableHeader() {
+    PdbHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "NFUL", 4);
+    header.version = 1;
+    header.dim = 3;
+    header.goalBlank = goalBlank;
+    header.tileCount = 9;
+    header.entries = FULL_TABLE_ENTRIES;
+    return header;
+}
+
+
+bool loadFullTable(const string& path) {
+    MappedFile file;
+    if (!mapFile(path, file)) return false;
+    PdbHeader expected = makeFullTableHeader();
+    if (file.size != sizeof(PdbHeader) + FULL_TABLE_ENTRIES / 2 || memcmp(file.data, &expected, sizeof(PdbHeader)) != 0) {
+        cerr << "Ignoring stale distance table " << path << endl;
+        unmapFile(file);
+        return false;
+    }
+    fullTable.file = file;
+    fullTable.table = file.data + sizeof(PdbHeader);
+    return true;
+}
+
+
+void releaseFullTable() {
+    unmapFile(fullTable.file);
+    fullTable = FullTable();
+}
+
+
+// Maps the 3x3 table for the current goal from pdbDir, building and
+// saving it first if it is missing.
+void prepareFullTable() {
+    ostringstream oss;
+    oss << pdbDir << "/full_3x3_b" << goalBlank << ".bin";
+    string path = oss.str();
+    releaseFullTable();
+    if (loadFullTable(path)) return;
+
+    cerr << "Building distance table " << path << endl;
+    fullTable.owned = buildFullTable(max(1, (int)thread::hardware_concurrency()));
+    PdbHeader header = makeFullTableHeader();
+    ofstream out(path, ios::binary);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)fullTable.owned.data(), fullTable.owned.size());
+    out.close();
+    if (out && loadFullTable(path)) {
+        vector<uint8_t>().swap(fullTable.owned);
     }
+    else {
+        cerr << "Cannot save " << path << ", keeping it in memory" << endl;
+        fullTable.table = fullTable.owned.data();
+    }
+}
+
+
+// Answers a 3x3 board without searching: from every board some move
+// lowers the distance by one, and the table tells which.
+bool descendFullTable(Search& search, const vector<int>& board) {
+    int cellOf[MAX_CELLS];
+    for (int t = 0; t < 9; t++) {
+        cellOf[t] = t == 0 ? goalBlank : goalPos[t];
+    }
+    size_t goal = fullTableIndex(cellOf);
+    for (int i = 0; i < 9; i++) {
+        cellOf[board[i]] = i;
+    }
+    int value = fullTableValue(fullTable.table, fullTableIndex(cellOf));
+    if (value == FULL_UNREACHED) return false;
+    while (fullTableIndex(cellOf) != goal) {
+        int blank = cellOf[0];
+        int r = blank / 3, c = blank % 3;
+        bool stepped = false;
+        for (int i = 0; i < 4 && !stepped; i++) {
+            int rr = r + DIR_ROW[i];
+            int cc = c + DIR_COL[i];
+            if (rr < 0 || rr >= 3 || cc < 0 || cc >= 3) continue;
+            int q = rr * 3 + cc;
+            int j = 1;
+            while (cellOf[j] != q) j++;
+            cellOf[0] = q;
+            cellOf[j] = blank;
+            if (fullTableValue(fullTable.table, fullTableIndex(cellOf)) == (value + 14) % 15) {
+                search.solution.push_back((uint8_t)i);
+                value = (value + 14) % 15;
+                stepped = true;
+            }
+            else {
+                cellOf[0] = blank;
+                cellOf[j] = q;
+            }
+        }
+        if (!stepped) return false;
+    }
+    search.found = true;
+    return true;
+}
+
+
+// order holds the goal positions, along the line, of the tiles in their
+// goal line. Tiles whose goal order is broken must leave the line, 2
+// extra moves each; at least (count - longest in-order subsequence).
+int outOfOrder(const int* order, int count) {
+    int longest = 0;
+    int ending[MAX_DIM];
+    for (int a = 0; a < count; a++) {
+        ending[a] = 1;
+        for (int b = 0; b < a; b++) {
+            if (order[b] < order[a]) ending[a] = max(ending[a], ending[b] + 1);
+        }
+        longest = max(longest, ending[a]);
+    }
+    return count - longest;
+}
+
 
-    int zeroPos = -1;
+// lineTiles are the tiles along row or column line, in order.
+int lineConflicts(const int* lineTiles, bool row, int line) {
+    int order[MAX_DIM];
+    int count = 0;
+    for (int k = 0; k < dim; k++) {
+        int t = lineTiles[k];
+        if (t == 0) continue;
+        int goalLine = row ? goalPos[t] / dim : goalPos[t] % dim;
+        if (goalLine == line) {
+            order[count++] = row ? goalPos[t] % dim : goalPos[t] / dim;
+        }
+    }
+    return outOfOrder(order, count);
+}
+
+
+int linearConflict(const vector<int>& board) {
+    int conflicts = 0;
+    for (int line = 0; line < dim; line++) {
+        int rowTiles[MAX_DIM], colTiles[MAX_DIM];
+        for (int k = 0; k < dim; k++) {
+            rowTiles[k] = board[line * dim + k];
+            colTiles[k] = board[k * dim + line];
+        }
+        conflicts += lineConflicts(rowTiles, true, line) + lineConflicts(colTiles, false, line);
+    }
+    return manhattanDistance(board) + 2 * conflicts;
+}
+
+
+// 3 bits per count for goal lines 0..dim-2 (the last is implied by the
+// line's size), then the blank's line.
+uint64_t encodeWalk(const int counts[MAX_DIM][MAX_DIM], int blankLine) {
+    uint64_t code = 0;
+    for (int r = 0; r < dim; r++) {
+        for (int g = 0; g < dim - 1; g++) {
+            code = (code << 3) | counts[r][g];
+        }
+    }
+    return (code << 3) | blankLine;
+}
+
+
+void decodeWalk(uint64_t code, int counts[MAX_DIM][MAX_DIM], int& blankLine) {
+    blankLine = (int)(code & 7);
+    code >>= 3;
+    for (int r = dim - 1; r >= 0; r--) {
+        int rest = (r == blankLine) ? dim - 1 : dim;
+        for (int g = dim - 2; g >= 0; g--) {
+            counts[r][g] = (int)(code & 7);
+            code >>= 3;
+            rest -= counts[r][g];
+        }
+        counts[r][dim - 1] = rest;
+    }
+}
+
+
+void walkCounts(const vector<int>& board, bool rows, int counts[MAX_DIM][MAX_DIM], int& blankLine) {
+    for (int r = 0; r < dim; r++) {
+        for (int g = 0; g < dim; g++) {
+            counts[r][g] = 0;
+        }
+    }
     for (int i = 0; i < (int)board.size(); i++) {
+        int line = rows ? i / dim : i % dim;
         if (board[i] == 0) {
-            zeroPos = i;
+            blankLine = line;
+            continue;
+        }
+        counts[line][rows ? goalPos[board[i]] / dim : goalPos[board[i]] % dim]++;
+    }
+}
+
+
+// BFS from the goal's counts over every reachable count matrix.
+void buildWalkTable(WalkTable& table, bool rows) {
+    int counts[MAX_DIM][MAX_DIM], blankLine;
+    walkCounts(goalState, rows, counts, blankLine);
+    vector<uint64_t> codes = { encodeWalk(counts, blankLine) };
+    table.index.clear();
+    table.index[codes[0]] = 0;
+    table.dist.assign(1, 0);
+    table.next.clear();
+
+    for (size_t state = 0; state < codes.size(); state++) {
+        decodeWalk(codes[state], counts, blankLine);
+        for (int side = 0; side < 2; side++) {
+            int from = blankLine + (side == 0 ? -1 : 1);
+            for (int g = 0; g < dim; g++) {
+                if (from < 0 || from >= dim || counts[from][g] == 0) {
+                    table.next.push_back(-1);
+                    continue;
+                }
+                counts[from][g]--;
+                counts[blankLine][g]++;
+                uint64_t code = encodeWalk(counts, from);
+                counts[blankLine][g]--;
+                counts[from][g]++;
+                auto found = table.index.find(code);
+                if (found == table.index.end()) {
+                    found = table.index.emplace(code, (int)codes.size()).first;
+                    codes.push_back(code);
+                    table.dist.push_back(table.dist[state] + 1);
+                }
+                table.next.push_back(found->second);
+            }
+        }
+    }
+}
+
+
+int walkState(const WalkTable& table, const vector<int>& board, bool rows) {
+    int counts[MAX_DIM][MAX_DIM], blankLine;
+    walkCounts(board, rows, counts, blankLine);
+    return table.index.at(encodeWalk(counts, blankLine));
+}
+
+
+int walkingDistance(const vector<int>& board) {
+    return walkRows.dist[walkState(walkRows, board, true)] + walkCols.dist[walkState(walkCols, board, false)];
+}
+
+
+int heuristicValue(const vector<int>& board) {
+    switch (heuristic) {
+    case LINEAR_CONFLICT:
+        return linearConflict(board);
+    case WALKING_DISTANCE:
+        return walkingDistance(board);
+    case PATTERN_DATABASE:
+        return patternHeuristic(board);
+    default:
+        return manhattanDistance(board);
+    }
+}
+
+
+template <int D>
+int cellValue(BoardWord<D> word, int field) {
+    return (int)(uint64_t)((word >> (CELL_BITS<D> * field)) & BoardWord<D>((1u << CELL_BITS<D>) - 1));
+}
+
+
+template <int D>
+BoardWord<D> packWord(const vector<int>& fields) {
+    BoardWord<D> word = 0;
+    for (int i = 0; i < (int)fields.size(); i++) {
+        word = word | (BoardWord<D>(fields[i]) << (CELL_BITS<D> * i));
+    }
+    return word;
+}
+
+
+template <int D>
+int packedPatternValue(const PatternDatabase& pdb, BoardWord<D> tileCells) {
+    int cellOf[MAX_CELLS];
+    for (int i = 0; i < (int)pdb.tiles.size(); i++) {
+        cellOf[i] = cellValue<D>(tileCells, pdb.tiles[i]);
+    }
+    return pdb.table[rankPattern(cellOf, (int)pdb.tiles.size(), D * D)];
+}
+
+
+template <int D>
+int packedLineConflicts(BoardWord<D> board, bool row, int line) {
+    const Geometry<D>& geo = GEOMETRY<D>;
+    int order[D];
+    int count = 0;
+    for (int k = 0; k < D; k++) {
+        int t = cellValue<D>(board, row ? line * D + k : k * D + line);
+        if (t == 0) continue;
+        int goal = geo.goalCell[goalBlank][t];
+        if ((row ? geo.row[goal] : geo.col[goal]) == line) {
+            order[count++] = row ? geo.col[goal] : geo.row[goal];
+        }
+    }
+    return outOfOrder(order, count);
+}
+
+
+void buildZobristKeys() {
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int t = 0; t < MAX_CELLS; t++) {
+        for (int p = 0; p < MAX_CELLS; p++) {
+            // splitmix64
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            zobristKey[t][p] = z ^ (z >> 31);
+        }
+    }
+}
+
+
+// Rounds the table down to a power of two slots; if that much memory
+// isn't available, halves it until an allocation succeeds.
+void allocateTranspositions(TranspositionTable& tt, size_t megabytes) {
+    size_t slots = 0;
+    if (megabytes > 0) {
+        slots = 2;
+        while (slots * 2 * sizeof(uint64_t) <= (megabytes << 20)) slots *= 2;
+    }
+    for (; slots >= 2; slots /= 2) {
+        try {
+            vector<atomic<uint64_t>> table(slots);
+            tt.slots.swap(table);
             break;
         }
+        catch (const bad_alloc&) {
+            cerr << "Cannot allocate " << (slots * sizeof(uint64_t) >> 20) << " MB transposition table" << endl;
+        }
+    }
+    tt.mask = slots - 1;
+}
+
+
+// Zeroing 64 MB takes longer than a whole 8-puzzle search, so boards up
+// to 3x3 get no table unless --tt-mb asks for one.
+size_t transpositionSize() {
+    if (transpositionMb >= 0) return transpositionMb;
+    return dim <= 3 ? 0 : 64;
+}
+
+
+// Starts a threshold iteration. Entries with an older stamp count as
+// empty, so the table only needs clearing when the stamp wraps.
+void nextSearchStamp(TranspositionTable& tt) {
+    if (++tt.stamp == 0) {
+        for (auto& slot : tt.slots) {
+            slot.store(0, memory_order_relaxed);
+        }
+        tt.stamp = 1;
+    }
+}
+
+
+// True if this iteration already reached the state at depth <= g, whose
+// subtree then covered everything this visit could; otherwise records g.
+// Races between threads can only lose an entry, never corrupt one.
+bool seenAtOrBelow(TranspositionTable& tt, uint64_t hash, int g) {
+    if (tt.slots.empty()) return false;
+    uint16_t stamp = tt.stamp;
+    uint64_t tag = hash >> 24;
+    uint64_t entry = (tag << 24) | ((uint64_t)min(g, 255) << 16) | stamp;
+    atomic<uint64_t>* pair = &tt.slots[hash & tt.mask & ~(size_t)1];
+    uint64_t slot[2] = { pair[0].load(memory_order_relaxed), pair[1].load(memory_order_relaxed) };
+    for (int k = 0; k < 2; k++) {
+        if ((slot[k] >> 24) == tag && (uint16_t)slot[k] == stamp) {
+            if ((int)((slot[k] >> 16) & 255) <= g) return true;
+            pair[k].store(entry, memory_order_relaxed);
+            return false;
+        }
+    }
+    // Replace a stale slot first, otherwise the one reached deeper, whose
+    // subtree is the cheaper one to search again.
+    int victim;
+    if ((uint16_t)slot[0] != stamp) victim = 0;
+    else if ((uint16_t)slot[1] != stamp) victim = 1;
+    else victim = ((slot[0] >> 16) & 255) >= ((slot[1] >> 16) & 255) ? 0 : 1;
+    pair[victim].store(entry, memory_order_relaxed);
+    return false;
+}
+
+
+// A search node. The heuristic is kept up to date per move; the
+// walking-distance table states are carried along only for that
+// heuristic.
+template <int D>
+struct SearchState {
+    BoardWord<D> board;
+    BoardWord<D> tileCells;
+    uint64_t hash;
+    int zeroPos;
+    int h;
+    int walkRow;
+    int walkCol;
+};
+
+
+template <int D>
+SearchState<D> packState(const vector<int>& board) {
+    vector<int> cellOfTile(board.size());
+    SearchState<D> state;
+    state.hash = 0;
+    for (int i = 0; i < (int)board.size(); i++) {
+        cellOfTile[board[i]] = i;
+        if (board[i] != 0) state.hash ^= zobristKey[board[i]][i];
     }
-    int r = zeroPos / dim;
-    int c = zeroPos % dim;
+    state.board = packWord<D>(board);
+    state.tileCells = packWord<D>(cellOfTile);
+    state.zeroPos = cellOfTile[0];
+    state.h = heuristicValue(board);
+    state.walkRow = heuristic == WALKING_DISTANCE ? walkState(walkRows, board, true) : 0;
+    state.walkCol = heuristic == WALKING_DISTANCE ? walkState(walkCols, board, false) : 0;
+    return state;
+}
+
+
+// The blank at cur.zeroPos makes move i onto newPos. Only the moved
+// tile's pattern, the two lines it leaves and enters across the move,
+// or one axis of the walking distance can change.
+template <int D>
+SearchState<D> moveBlank(const SearchState<D>& cur, int i, int newPos) {
+    typedef BoardWord<D> Word;
+    const int bits = CELL_BITS<D>;
+    const Geometry<D>& geo = GEOMETRY<D>;
+    SearchState<D> next = cur;
+    int zeroPos = cur.zeroPos;
+    int tile = cellValue<D>(cur.board, newPos);
+    next.board = cur.board - (Word(tile) << (bits * newPos)) + (Word(tile) << (bits * zeroPos));
+    next.tileCells = cur.tileCells - (Word(newPos) << (bits * tile)) + (Word(zeroPos) << (bits * tile));
+    next.hash = cur.hash ^ zobristKey[tile][newPos] ^ zobristKey[tile][zeroPos];
+    next.zeroPos = newPos;
+
+    int goal = geo.goalCell[goalBlank][tile];
+    int manhattanDelta = geo.distance[goal][zeroPos] - geo.distance[goal][newPos];
+    // Moves 2 and 3 are vertical.
+    bool vertical = i >= 2;
+    TIME_HEURISTIC();
+    switch (heuristic) {
+    case LINEAR_CONFLICT: {
+        int lineFrom = vertical ? geo.row[newPos] : geo.col[newPos];
+        int lineTo = vertical ? geo.row[zeroPos] : geo.col[zeroPos];
+        int before = packedLineConflicts<D>(cur.board, vertical, lineFrom)
+            + packedLineConflicts<D>(cur.board, vertical, lineTo);
+        int after = packedLineConflicts<D>(next.board, vertical, lineFrom)
+            + packedLineConflicts<D>(next.board, vertical, lineTo);
+        next.h = cur.h + manhattanDelta + 2 * (after - before);
+        break;
+    }
+    case WALKING_DISTANCE:
+        if (vertical) {
+            next.walkRow = walkRows.next[(cur.walkRow * 2 + (i == 3)) * D + geo.row[goal]];
+        }
+        else {
+            next.walkCol = walkCols.next[(cur.walkCol * 2 + (i == 1)) * D + geo.col[goal]];
+        }
+        next.h = walkRows.dist[next.walkRow] + walkCols.dist[next.walkCol];
+        break;
+    case PATTERN_DATABASE: {
+        const PatternDatabase& pdb = patterns[patternOf[tile]];
+        next.h = cur.h + packedPatternValue<D>(pdb, next.tileCells) - packedPatternValue<D>(pdb, cur.tileCells);
+        break;
+    }
+    default:
+        next.h = cur.h + manhattanDelta;
+        break;
+    }
+    return next;
+}
+
+
+// path is a move stack with room for threshold + 1 moves; the move made
+// at depth g goes to path[g].
+template <int D>
+bool dfs(Search& search, const SearchState<D>& state, int g, int threshold, int& minNextThreshold,
+    vector<uint8_t>& path, int lastMove) {
+    if (search.done.load(memory_order_relaxed)) return false;
+    int f = g + state.h;
+    if (f > threshold) {
+        COUNT_NODE(pruned);
+        minNextThreshold = min(minNextThreshold, f);
+        return false;
+    }
+    if (state.board == goalBoard<D>) {
+        if (!search.done.exchange(true)) {
+            search.solution.assign(path.begin(), path.begin() + g);
+            search.found = true;
+        }
+        return true;
+    }
+    if (seenAtOrBelow(search.table, state.hash, g)) {
+        COUNT_NODE(transposed);
+        return false;
+    }
+    COUNT_NODE(expanded);
 
     for (int i = 0; i < 4; i++) {
         if (i == (lastMove ^ 1)) continue;
 
-        int rr = r + DIR_ROW[i];
-        int cc = c + DIR_COL[i];
-        if (rr < 0 || rr >= dim || cc < 0 || cc >= dim)
-            continue;
+        int newPos = GEOMETRY<D>.neighbor[state.zeroPos][i];
+        if (newPos < 0) continue;
 
-        int newPos = rr * dim + cc;
-        swap(board[zeroPos], board[newPos]);
-        path.push_back(DIR_NAME[i]);
+        path[g] = (uint8_t)i;
+        COUNT_NODE(generated);
 
-        if (dfs(board, g + 1, threshold, minNextThreshold, path, i)) {
+        if (dfs<D>(search, moveBlank<D>(state, i, newPos), g + 1, threshold, minNextThreshold, path, i)) {
             return true;
         }
-
-        path.pop_back();
-        swap(board[zeroPos], board[newPos]);
     }
 
     return false;
 }
 
-bool idaStar(vector<int>& startBoard) {
-    int threshold = manhattanDistance(startBoard);
+#ifdef SEARCH_STATS
+void beginIteration(Search& search, int threshold) {
+    IterationStats stats;
+    stats.threshold = threshold;
+    stats.start = steady_clock::now();
+    search.iterations.push_back(stats);
+    nodeCounters = NodeCounters();
+}
+
+
+void addNodeCounters(Search& search) {
+    lock_guard<mutex> guard(search.statsLock);
+    NodeCounters& total = search.iterations.back().nodes;
+    total.expanded += nodeCounters.expanded;
+    total.generated += nodeCounters.generated;
+    total.pruned += nodeCounters.pruned;
+    total.transposed += nodeCounters.transposed;
+    total.heuristicNanos += nodeCounters.heuristicNanos;
+    nodeCounters = NodeCounters();
+}
+
+
+void endIteration(Search& search) {
+    IterationStats& stats = search.iterations.back();
+    stats.seconds = duration_cast<chrono::duration<double>>(steady_clock::now() - stats.start).count();
+}
+
+
+// The effective branching factor b*: the branching of a uniform tree of
+// the given depth with as many nodes as were generated, that is, the b
+// with b + b^2 + ... + b^depth = generated. 0 when there is no depth.
+double effectiveBranching(uint64_t generated, int depth) {
+    if (depth <= 0 || generated == 0) return 0;
+    auto treeSize = [depth](double b) {
+        double size = 0, level = 1;
+        for (int i = 0; i < depth && size <= 1e300; i++) {
+            level *= b;
+            size += level;
+        }
+        return size;
+    };
+    double lo = 0, hi = max(1.0, (double)generated);
+    for (int step = 0; step < 100; step++) {
+        double mid = (lo + hi) / 2;
+        if (treeSize(mid) < generated) lo = mid;
+        else hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+
+// One JSON object per run: the iterations in order, then the totals.
+// growth is an iteration's generated nodes over the previous one's, and
+// effectiveBranching is b* over the whole run at the solution depth.
+// nodesPerSecond counts generated nodes; heuristicSeconds is sampled.
+string statsJson(const Search& search) {
+    const char* names[] = { "manhattan", "linear", "walking", "pdb" };
+    auto counters = [](ostringstream& out, const NodeCounters& nodes, double seconds) {
+        out << "\"expanded\":" << nodes.expanded << ",\"generated\":" << nodes.generated
+            << ",\"pruned\":" << nodes.pruned << ",\"transposed\":" << nodes.transposed
+            << ",\"seconds\":" << seconds
+            << ",\"nodesPerSecond\":" << (seconds > 0 ? nodes.generated / seconds : 0.0)
+            << ",\"heuristicSeconds\":" << nodes.heuristicNanos * 1e-9;
+    };
+    ostringstream out;
+    out << "{\"dim\":" << dim << ",\"heuristic\":\"" << names[heuristic] << "\",\"found\":"
+        << (search.found ? "true" : "false") << ",\"length\":" << search.solution.size() << ",\"iterations\":[";
+    NodeCounters total;
+    double seconds = 0;
+    for (size_t k = 0; k < search.iterations.size(); k++) {
+        const IterationStats& stats = search.iterations[k];
+        uint64_t previous = k == 0 ? 0 : search.iterations[k - 1].nodes.generated;
+        out << (k == 0 ? "" : ",") << "{\"threshold\":" << stats.threshold << ",";
+        counters(out, stats.nodes, stats.seconds);
+        out << ",\"growth\":" << (previous > 0 ? (double)stats.nodes.generated / previous : 0.0) << "}";
+        total.expanded += stats.nodes.expanded;
+        total.generated += stats.nodes.generated;
+        total.pruned += stats.nodes.pruned;
+        total.transposed += stats.nodes.transposed;
+        total.heuristicNanos += stats.nodes.heuristicNanos;
+        seconds += stats.seconds;
+    }
+    out << "],\"total\":{";
+    counters(out, total, seconds);
+    int depth = search.found ? (int)search.solution.size() : 0;
+    out << ",\"effectiveBranching\":" << effectiveBranching(total.generated, depth) << "}}";
+    return out.str();
+}
+#endif
+
+
+template <int D>
+bool idaStar(Search& search, const vector<int>& startBoard) {
+    SearchState<D> start = packState<D>(startBoard);
+    int threshold = start.h;
+    vector<uint8_t> path;
 
     while (true) {
         int minNextThreshold = INT_MAX;
-        vector<string> path;
+        if ((int)path.size() <= threshold) path.resize(2 * threshold + 1);
+        nextSearchStamp(search.table);
+#ifdef SEARCH_STATS
+        beginIteration(search, threshold);
+#endif
 
-        if (dfs(startBoard, 0, threshold, minNextThreshold, path, -1)) {
-            return foundSolution;
+        bool solved = dfs<D>(search, start, 0, threshold, minNextThreshold, path, -1);
+#ifdef SEARCH_STATS
+        addNodeCounters(search);
+        endIteration(search);
+#endif
+        if (solved) {
+            return search.found;
         }
         if (minNextThreshold == INT_MAX) {
             return false;
@@ -152,42 +1400,431 @@ bool idaStar(vector<int>& startBoard) {
     }
 }
 
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+// A frontier node of the parallel search and the moves that reach it.
+template <int D>
+struct Subproblem {
+    SearchState<D> state;
+    int g;
+    int lastMove;
+    vector<uint8_t> path;
+};
 
-    int N, I;
-    cin >> N >> I;
+struct WorkQueue {
+    mutex lock;
+    deque<int> items;
+};
+
+const int FRONTIER_TARGET = 4096;
+
+
+// Expands the root breadth-first until a level holds FRONTIER_TARGET
+// nodes. A goal met on the way is the shortest solution. A node is
+// counted as generated when its level is expanded; the final level is
+// counted when its nodes are dealt to the workers.
+template <int D>
+vector<Subproblem<D>> buildFrontier(Search& search, const SearchState<D>& start) {
+    vector<Subproblem<D>> level = { { start, 0, -1, {} } };
+    while ((int)level.size() < FRONTIER_TARGET) {
+        vector<Subproblem<D>> next;
+        for (const auto& node : level) {
+            if (node.g > 0) COUNT_NODE(generated);
+            if (node.state.board == goalBoard<D>) {
+                search.solution = node.path;
+                search.found = true;
+                return {};
+            }
+            COUNT_NODE(expanded);
+            for (int i = 0; i < 4; i++) {
+                if (i == (node.lastMove ^ 1)) continue;
+                int newPos = GEOMETRY<D>.neighbor[node.state.zeroPos][i];
+                if (newPos < 0) continue;
+                next.push_back({ moveBlank<D>(node.state, i, newPos), node.g + 1, i, node.path });
+                next.back().path.push_back((uint8_t)i);
+            }
+        }
+        level.swap(next);
+    }
+    return level;
+}
 
-    dim = (int)sqrt(N + 1);
 
-    vector<int> startBoard(N + 1);
+// Takes from the front of queue t, or steals from the back of another.
+bool takeWork(vector<WorkQueue>& queues, int t, int& item) {
+    for (int k = 0; k < (int)queues.size(); k++) {
+        WorkQueue& queue = queues[(t + k) % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.items.empty()) continue;
+        if (k == 0) {
+            item = queue.items.front();
+            queue.items.pop_front();
+        }
+        else {
+            item = queue.items.back();
+            queue.items.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+
+// IDA* with every threshold iteration split over the frontier. Workers
+// share the smallest f above the threshold through an atomic, and the
+// first to reach the goal stops the rest. Every solution found within
+// an iteration has length equal to its threshold, so it is optimal.
+template <int D>
+bool idaStarParallel(Search& search, const vector<int>& startBoard) {
+    SearchState<D> start = packState<D>(startBoard);
+    int threshold = start.h;
+#ifdef SEARCH_STATS
+    // Building the frontier is counted with the first iteration, so a
+    // goal met on the way still leaves a record.
+    beginIteration(search, threshold);
+#endif
+    vector<Subproblem<D>> frontier = buildFrontier<D>(search, start);
+#ifdef SEARCH_STATS
+    addNodeCounters(search);
+    if (search.found) endIteration(search);
+#endif
+    if (search.found) return true;
+
+    vector<WorkQueue> queues(threads);
+    vector<vector<uint8_t>> paths(threads);
+    for (int iteration = 0; ; iteration++) {
+        for (int k = 0; k < (int)frontier.size(); k++) {
+            queues[k % threads].items.push_back(k);
+        }
+        atomic<int> nextThreshold(INT_MAX);
+        nextSearchStamp(search.table);
+#ifdef SEARCH_STATS
+        if (iteration > 0) beginIteration(search, threshold);
+#endif
+        parallelFor(threads, [&](int t) {
+            int localNext = INT_MAX;
+            vector<uint8_t>& path = paths[t];
+            int depth = max(threshold, frontier.front().g);
+            if ((int)path.size() <= depth) path.resize(2 * depth + 1);
+            int item;
+            while (!search.done.load(memory_order_relaxed) && takeWork(queues, t, item)) {
+                const Subproblem<D>& sub = frontier[item];
+                COUNT_NODE(generated);
+                copy(sub.path.begin(), sub.path.end(), path.begin());
+                dfs<D>(search, sub.state, sub.g, threshold, localNext, path, sub.lastMove);
+            }
+#ifdef SEARCH_STATS
+            addNodeCounters(search);
+#endif
+            int seen = nextThreshold.load();
+            while (localNext < seen && !nextThreshold.compare_exchange_weak(seen, localNext)) {
+            }
+        });
+#ifdef SEARCH_STATS
+        endIteration(search);
+#endif
+
+        if (search.found) {
+            return true;
+        }
+        if (nextThreshold == INT_MAX) {
+            return false;
+        }
+        threshold = nextThreshold;
+
+        if (threshold > 100000) {
+            return false;
+        }
+    }
+}
+
+template <int D>
+bool solve(Search& search, const vector<int>& startBoard, int searchThreads) {
+    return searchThreads > 1 ? idaStarParallel<D>(search, startBoard) : idaStar<D>(search, startBoard);
+}
+
+
+bool solveBoard(Search& search, const vector<int>& startBoard, int searchThreads) {
+    search.solution.clear();
+    search.found = false;
+    search.done.store(false);
+#ifdef SEARCH_STATS
+    search.iterations.clear();
+#endif
+    if (fullTable.table != nullptr) {
+        return descendFullTable(search, startBoard);
+    }
+    switch (dim) {
+    case 2:
+        return solve<2>(search, startBoard, searchThreads);
+    case 3:
+        return solve<3>(search, startBoard, searchThreads);
+    case 4:
+        return solve<4>(search, startBoard, searchThreads);
+    default:
+        return solve<5>(search, startBoard, searchThreads);
+    }
+}
+
+
+// The board is solvable iff the parity of the permutation taking it to
+// the goal (the blank counted as a tile) matches the parity of the
+// blank's distance to its goal cell. One pass over the cycles, O(n).
+bool isSolvable(const vector<int>& board) {
+    int cells = (int)board.size();
+    vector<int> target(cells);
+    vector<bool> seen(cells, false);
+    for (int i = 0; i < cells; i++) {
+        if (board[i] < 0 || board[i] >= cells || seen[board[i]]) return false;
+        seen[board[i]] = true;
+        target[i] = board[i] == 0 ? goalBlank : goalPos[board[i]];
+    }
+    int cycles = 0;
+    fill(seen.begin(), seen.end(), false);
+    for (int i = 0; i < cells; i++) {
+        if (seen[i]) continue;
+        cycles++;
+        for (int j = i; !seen[j]; j = target[j]) {
+            seen[j] = true;
+        }
+    }
+    int blank = (int)(find(board.begin(), board.end(), 0) - board.begin());
+    int blankDistance = abs(blank / dim - goalBlank / dim) + abs(blank % dim - goalBlank % dim);
+    return (cells - cycles) % 2 == blankDistance % 2;
+}
+
+
+bool readBoard(istream& in, int& N, int& I, vector<int>& board) {
+    if (!(in >> N >> I) || N < 0) return false;
+    board.resize(N + 1);
     for (int i = 0; i < N + 1; i++) {
-        cin >> startBoard[i];
+        if (!(in >> board[i])) return false;
     }
+    return true;
+}
 
+
+// Sets up the goal and the heuristic tables for N-puzzles with the
+// blank's goal at I. A heuristic the board size doesn't support falls
+// back to a lighter one.
+bool prepareGoal(int N, int I, Heuristic requested) {
+    dim = (int)sqrt(N + 1);
+    if (dim * dim != N + 1 || dim < 2 || dim > MAX_DIM) {
+        cerr << "Boards from 2x2 up to " << MAX_DIM << "x" << MAX_DIM << " are supported" << endl;
+        return false;
+    }
     goalState = buildGoalState(N, I);
     goalPos = buildGoalPos(goalState);
+    goalBlank = (int)(find(goalState.begin(), goalState.end(), 0) - goalState.begin());
+    switch (dim) {
+    case 2:
+        goalBoard<2> = packWord<2>(goalState);
+        break;
+    case 3:
+        goalBoard<3> = packWord<3>(goalState);
+        break;
+    case 4:
+        goalBoard<4> = packWord<4>(goalState);
+        break;
+    default:
+        goalBoard<5> = packWord<5>(goalState);
+        break;
+    }
 
-    auto start = high_resolution_clock::now(); 
-
-    foundSolution = false;
-    bool ok = idaStar(startBoard);
+    releasePatternDatabases();
+    heuristic = requested;
+    if (heuristic == PATTERN_DATABASE && !preparePatternDatabases()) {
+        cerr << "No pattern databases for " << dim << "x" << dim << " boards, using Manhattan distance" << endl;
+        heuristic = MANHATTAN;
+    }
+    if (heuristic == WALKING_DISTANCE && dim > WALK_MAX_DIM) {
+        cerr << "Walking distance supports boards up to " << WALK_MAX_DIM << "x" << WALK_MAX_DIM
+             << ", using linear conflict" << endl;
+        heuristic = LINEAR_CONFLICT;
+    }
+    if (heuristic == WALKING_DISTANCE) {
+        buildWalkTable(walkRows, true);
+        buildWalkTable(walkCols, false);
+    }
+    releaseFullTable();
+    if (useFullTable && dim == 3) {
+        prepareFullTable();
+    }
+    else if (useFullTable) {
+        cerr << "The distance table covers 3x3 boards only, searching instead" << endl;
+    }
+    return true;
+}
 
-    auto end = high_resolution_clock::now(); 
-    double exec_time = duration_cast<chrono::duration<double>>(end - start).count();
 
+void printSolution(ostream& out, const Search& search, bool ok) {
     if (!ok) {
-        cout << -1 << "\n";
+        out << -1 << "\n";
+        return;
     }
-    else {
-        cout << finalPath.size() << "\n";
-        for (auto& step : finalPath) {
-            cout << step << "\n";
+    out << search.solution.size() << "\n";
+    for (uint8_t step : search.solution) {
+        out << DIR_NAME[step] << "\n";
+    }
+}
+
+
+// Solves every board in the input, answers in input order separated by
+// blank lines. Boards sharing a goal are solved together, so the goal's
+// heuristic tables are built once and read by all workers; each worker
+// has its own search state and transposition table. Unsolvable boards
+// are answered -1 without a search. A malformed or truncated board stops
+// the reading: the boards before it are still solved, but false is
+// returned.
+bool batchSolve(istream& in, Heuristic requested) {
+    struct Job {
+        int N, I;
+        vector<int> board;
+    };
+    vector<Job> jobs;
+    Job job;
+    bool valid = true;
+    while (!(in >> ws).eof()) {
+        if (!readBoard(in, job.N, job.I, job.board)) {
+            cerr << "Invalid board " << jobs.size() + 1 << " in the batch" << endl;
+            valid = false;
+            break;
+        }
+        jobs.push_back(job);
+    }
+
+    vector<int> order(jobs.size());
+    for (int k = 0; k < (int)jobs.size(); k++) {
+        order[k] = k;
+    }
+    stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return make_pair(jobs[a].N, jobs[a].I) < make_pair(jobs[b].N, jobs[b].I);
+    });
+
+    // Transposition tables are allocated by the first group that searches;
+    // boards answered from the distance table don't need them.
+    vector<Search> searches(threads);
+    vector<string> answers(jobs.size());
+    vector<double> latency(jobs.size(), 0.0);
+#ifdef SEARCH_STATS
+    vector<string> stats(jobs.size());
+#endif
+    auto start = high_resolution_clock::now();
+
+    for (size_t from = 0; from < order.size(); ) {
+        size_t to = from;
+        while (to < order.size() && jobs[order[to]].N == jobs[order[from]].N && jobs[order[to]].I == jobs[order[from]].I) {
+            to++;
+        }
+        bool ready = prepareGoal(jobs[order[from]].N, jobs[order[from]].I, requested);
+        atomic<size_t> next(from);
+        parallelFor(threads, [&](int t) {
+            for (size_t k = next++; k < to; k = next++) {
+                int id = order[k];
+                auto boardStart = high_resolution_clock::now();
+                if (fullTable.table == nullptr && searches[t].table.slots.empty()) {
+                    allocateTranspositions(searches[t].table, transpositionSize() / threads);
+                }
+                bool ok = ready && isSolvable(jobs[id].board) && solveBoard(searches[t], jobs[id].board, 1);
+                ostringstream out;
+                printSolution(out, searches[t], ok);
+                answers[id] = out.str();
+#ifdef SEARCH_STATS
+                stats[id] = statsJson(searches[t]);
+#endif
+                latency[id] = duration_cast<chrono::duration<double>>(high_resolution_clock::now() - boardStart).count();
+            }
+        });
+        from = to;
+    }
+
+    double total = duration_cast<chrono::duration<double>>(high_resolution_clock::now() - start).count();
+    for (size_t id = 0; id < jobs.size(); id++) {
+        cout << (id == 0 ? "" : "\n") << answers[id];
+        cerr << "Board " << id + 1 << ": " << fixed << setprecision(3) << latency[id] << " seconds" << endl;
+#ifdef SEARCH_STATS
+        cerr << stats[id] << endl;
+#endif
+    }
+    cerr << "Solved " << jobs.size() << " boards in " << fixed << setprecision(3) << total << " seconds ("
+        << (total > 0 ? jobs.size() / total : 0.0) << " boards/s)" << endl;
+    return valid;
+}
+
+int main(int argc, char* argv[]) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    bool batch = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--heuristic" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "manhattan") {
+                heuristic = MANHATTAN;
+            }
+            else if (name == "linear") {
+                heuristic = LINEAR_CONFLICT;
+            }
+            else if (name == "walking") {
+                heuristic = WALKING_DISTANCE;
+            }
+            else if (name == "pdb") {
+                heuristic = PATTERN_DATABASE;
+            }
+            else {
+                cerr << "Unknown heuristic " << name << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--pdb-dir" && i + 1 < argc) {
+            pdbDir = argv[++i];
+        }
+        else if (arg == "--tt-mb" && i + 1 < argc) {
+            transpositionMb = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--full-table") {
+            useFullTable = true;
         }
+        else if (arg == "--batch") {
+            batch = true;
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = max(1, atoi(argv[++i]));
+        }
+        else {
+            cerr << "Usage: " << argv[0] << " [--heuristic manhattan|linear|walking|pdb] [--pdb-dir DIR] [--threads T] [--tt-mb MB] [--full-table] [--batch]" << endl;
+            return 1;
+        }
+    }
+
+    buildZobristKeys();
+    if (batch) {
+        return batchSolve(cin, heuristic) ? 0 : 1;
     }
 
+    int N, I;
+    vector<int> startBoard;
+    if (!readBoard(cin, N, I, startBoard) || !prepareGoal(N, I, heuristic)) {
+        return 1;
+    }
+
+    Search search;
+    if (fullTable.table == nullptr) {
+        allocateTranspositions(search.table, transpositionSize());
+    }
+
+    auto start = high_resolution_clock::now(); 
+
+    bool ok = isSolvable(startBoard) && solveBoard(search, startBoard, threads);
+
+    auto end = high_resolution_clock::now(); 
+    double exec_time = duration_cast<chrono::duration<double>>(end - start).count();
+
+    printSolution(cout, search, ok);
+
+#ifdef SEARCH_STATS
+    cerr << statsJson(search) << endl;
+#endif
     cerr << "Execution Time: " << fixed << setprecision(3) << exec_time << " seconds" << endl;
 
     return 0;
-}
\ No newline at end of file
+}
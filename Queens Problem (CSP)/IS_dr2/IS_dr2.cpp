@@ -1,130 +1,480 @@
 #include <iostream>
-#include <vector>
+#include <algorithm>
+#include <bit>
 #include <chrono>
 #include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <new>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define QUEENS_LANES 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUEENS_LANES 16
+#endif
+
 using namespace std;
 using namespace chrono;
 
-int n;
-bool has_conflicts;
-int* q_pos;
-int* row_conf;
-int* diag1;
-int* diag2;
+const size_t CACHE_LINE = 64;
+
+// Set by the first solver to clear its board; the others see it on
+// their next step and give up.
+atomic<bool> solved(false);
+
+// splitmix64: one 64-bit state, full period, and good enough mixing for
+// picking columns and breaking ties.
+struct Rng {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, bound), rejecting the short tail that makes
+    // next() % bound biased.
+    uint64_t below(uint64_t bound) {
+        uint64_t threshold = (0 - bound) % bound;
+        uint64_t x;
+        do {
+            x = next();
+        } while (x < threshold);
+        return x % bound;
+    }
+
+    // Uniform in (0, 1].
+    double unit() {
+        return ((next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// All solver state. The arrays share one allocation, each starting on
+// its own cache line. A queen only ever moves to a row whose three
+// counters sum to the column's minimum, which is at most 2 (the n - 1
+// other queens spread over n rows and 2n distinct diagonals), so moves
+// never push a counter past 3 and a byte per counter is plenty.
+struct Board {
+    int n;
+    uint32_t* q_pos;
+    uint8_t* row_conf;
+    uint8_t* diag1;
+    uint8_t* diag2;
+    // Columns whose queen may be under attack; in_conf marks members.
+    // Every attacking pair keeps at least one of its queens here, so an
+    // empty set means the board is solved. Entries whose attackers have
+    // all moved away are dropped when drawn.
+    uint32_t* conf_cols;
+    uint64_t* in_conf;
+    uint32_t conf_count;
+    Rng rng;
+    void* arena;
+};
+
+size_t alignedSize(size_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+void allocateBoard(Board& b, int n) {
+    size_t cols = alignedSize(n * sizeof(uint32_t));
+    size_t rows = alignedSize(n);
+    size_t diags = alignedSize(2 * (size_t)n - 1);
+    size_t bits = alignedSize((n + 63) / 64 * sizeof(uint64_t));
+    uint8_t* p = (uint8_t*)::operator new(2 * cols + rows + 2 * diags + bits, align_val_t(CACHE_LINE));
+    b.n = n;
+    b.arena = p;
+    b.q_pos = (uint32_t*)p;
+    p += cols;
+    b.conf_cols = (uint32_t*)p;
+    p += cols;
+    b.in_conf = (uint64_t*)p;
+    p += bits;
+    b.row_conf = p;
+    p += rows;
+    b.diag1 = p;
+    p += diags;
+    b.diag2 = p;
+}
+
+void freeBoard(Board& b) {
+    ::operator delete(b.arena, align_val_t(CACHE_LINE));
+    b.arena = nullptr;
+}
+
+void clearCounters(Board& b) {
+    memset(b.row_conf, 0, b.n);
+    memset(b.diag1, 0, 2 * (size_t)b.n - 1);
+    memset(b.diag2, 0, 2 * (size_t)b.n - 1);
+}
+
+void placeQueen(Board& b, int row, int col) {
+    b.q_pos[col] = row;
+    b.row_conf[row]++;
+    b.diag1[col - row + b.n - 1]++;
+    b.diag2[col + row]++;
+}
+
+// The explicit construction: row by row, the even columns and then the
+// odd ones (counting from 1). For n mod 6 of 2 the odd run becomes
+// 3, 1, 7, 9, ..., 5; for n mod 6 of 3 the evens start at 4 with 2 last
+// and the odds start at 5 with 1, 3 last. Every n >= 4 starts solved.
+void initQueens(Board& b) {
+    int n = b.n;
+    clearCounters(b);
+    bool fix2 = n % 6 == 2 && n >= 8;
+    bool fix3 = n % 6 == 3 && n >= 9;
+    int row = 0;
+    for (int col = fix3 ? 4 : 2; col <= n; col += 2) {
+        placeQueen(b, row++, col - 1);
+    }
+    if (fix3) {
+        placeQueen(b, row++, 1);
+    }
+    if (fix2) {
+        placeQueen(b, row++, 2);
+        placeQueen(b, row++, 0);
+    }
+    for (int col = fix2 ? 7 : fix3 ? 5 : 1; col <= n; col += 2) {
+        placeQueen(b, row++, col - 1);
+    }
+    if (fix2) {
+        placeQueen(b, row++, 4);
+    }
+    if (fix3) {
+        placeQueen(b, row++, 0);
+        placeQueen(b, row++, 2);
+    }
+}
+
+// Restarts from a random permutation, one queen per row. Its diagonals
+// hold a handful of queens at most; a shuffle that would overflow a
+// counter is simply drawn again.
+void shuffleQueens(Board& b) {
+    int n = b.n;
+    bool overflow;
+    do {
+        clearCounters(b);
+        for (int col = 0; col < n; col++) {
+            b.q_pos[col] = col;
+        }
+        for (int col = n - 1; col > 0; col--) {
+            swap(b.q_pos[col], b.q_pos[b.rng.below(col + 1)]);
+        }
+        overflow = false;
+        for (int col = 0; col < n && !overflow; col++) {
+            int row = b.q_pos[col];
+            uint8_t& d1 = b.diag1[col - row + n - 1];
+            uint8_t& d2 = b.diag2[col + row];
+            overflow = d1 == UINT8_MAX || d2 == UINT8_MAX;
+            b.row_conf[row]++;
+            d1++;
+            d2++;
+        }
+    } while (overflow);
+}
+
+bool isConflicted(const Board& b, int col) {
+    int row = b.q_pos[col];
+    return b.row_conf[row] > 1 || b.diag1[col - row + b.n - 1] > 1 || b.diag2[col + row] > 1;
+}
+
+void addConfCol(Board& b, int col) {
+    uint64_t bit = 1ull << (col % 64);
+    if (!(b.in_conf[col / 64] & bit)) {
+        b.in_conf[col / 64] |= bit;
+        b.conf_cols[b.conf_count++] = col;
+    }
+}
 
-void initQueens() {
-    int col = 1;
-    for (int row = 0; row < n; row++) {
-        q_pos[col] = row;
-        row_conf[row]++;
-        diag1[col - row + n - 1]++;
-        diag2[col + row]++;
-        col += 2;
-        if (col >= n) {
-            col = 0;
+void initConfCols(Board& b) {
+    memset(b.in_conf, 0, (b.n + 63) / 64 * sizeof(uint64_t));
+    b.conf_count = 0;
+    for (int col = 0; col < b.n; col++) {
+        if (isConflicted(b, col)) {
+            addConfCol(b, col);
         }
     }
 }
 
-int getMaxConfCol() {
-    int max_conf = -1;
-    vector<int> max_conf_cols;
-    for (int col = 0; col < n; col++) {
-        int row = q_pos[col];
-        int conf = row_conf[row] + diag1[col - row + n - 1] + diag2[col + row] - 3;
-        if (conf == max_conf) {
-            max_conf_cols.push_back(col);
+// A random conflicted column, or -1 once there are none.
+int getConfCol(Board& b) {
+    while (b.conf_count > 0) {
+        uint32_t slot = (uint32_t)b.rng.below(b.conf_count);
+        int col = b.conf_cols[slot];
+        if (isConflicted(b, col)) {
+            return col;
         }
-        else if (conf > max_conf) {
-            max_conf = conf;
-            max_conf_cols = { col };
+        b.conf_cols[slot] = b.conf_cols[--b.conf_count];
+        b.in_conf[col / 64] &= ~(1ull << (col % 64));
+    }
+    return -1;
+}
+
+// The row with the fewest conflicts so far, tie-broken by reservoir
+// sampling: the j-th row tied at the minimum replaces the pick with
+// probability 1/j. Rather than draw for every tie, the index of the
+// next replacing tie is drawn directly (it exceeds m with probability
+// j/m), so a scan costs O(log ties) draws and keeps no candidate list.
+struct RowPick {
+    int min_conf;
+    long long ties;
+    long long next;
+    int row;
+};
+
+inline void lowerMin(RowPick& pick, int conf) {
+    pick.min_conf = conf;
+    pick.ties = 0;
+    pick.next = 1;
+}
+
+// mask holds the rows from first on that tie at the minimum.
+inline void takeTies(RowPick& pick, Rng& rng, int first, unsigned mask) {
+    int count = popcount(mask);
+    while (pick.next <= pick.ties + count) {
+        unsigned rest = mask;
+        for (long long k = pick.next - pick.ties - 1; k > 0; k--) {
+            rest &= rest - 1;
         }
+        pick.row = first + countr_zero(rest);
+        pick.next = (long long)(pick.next / rng.unit()) + 1;
     }
-    if (max_conf == 0) {
-        has_conflicts = false;
+    pick.ties += count;
+}
+
+inline void offerRow(RowPick& pick, Rng& rng, int row, int conf) {
+    if (conf < pick.min_conf) {
+        lowerMin(pick, conf);
+    }
+    if (conf == pick.min_conf) {
+        takeTies(pick, rng, row, 1u);
     }
-    return max_conf_cols[rand() % max_conf_cols.size()];
 }
 
-int getMinConfRow(int col) {
-    int min_conf = n + 1;
-    vector<int> min_conf_rows;
-    for (int row = 0; row < n; row++) {
-        int conf = row_conf[row] + diag1[col - row + n - 1] + diag2[col + row];
-        if (q_pos[col] == row) {
-            conf -= 3;
+// Along column col, diag2 runs forward from col and diag1 backward from
+// col + n - 1, so every counter is read in contiguous blocks; the diag1
+// block is reversed in register. Sums saturate at 255, far above any
+// minimum. A block is taken apart lane by lane only when it lowers the
+// minimum.
+int getMinConfRow(Board& b, int col) {
+    int n = b.n;
+    // Lift the queen off so its own row costs what staying there does.
+    int cur_row = b.q_pos[col];
+    b.row_conf[cur_row]--;
+    b.diag1[col - cur_row + n - 1]--;
+    b.diag2[col + cur_row]--;
+
+    RowPick pick = { UINT8_MAX, 0, 1, cur_row };
+    const uint8_t* row_conf = b.row_conf;
+    const uint8_t* d1 = b.diag1 + col + n - 1;
+    const uint8_t* d2 = b.diag2 + col;
+    int row = 0;
+#if QUEENS_LANES == 32
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i min_conf = _mm256_set1_epi8((char)pick.min_conf);
+    for (; row + 32 <= n; row += 32) {
+        __m256i conf = _mm256_loadu_si256((const __m256i*)(row_conf + row));
+        conf = _mm256_adds_epu8(conf, _mm256_loadu_si256((const __m256i*)(d2 + row)));
+        __m256i back = _mm256_loadu_si256((const __m256i*)(d1 - row - 31));
+        back = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(back, reverse), 0x4E);
+        conf = _mm256_adds_epu8(conf, back);
+        __m256i lower = _mm256_cmpeq_epi8(_mm256_min_epu8(conf, min_conf), min_conf);
+        if ((unsigned)_mm256_movemask_epi8(lower) != 0xFFFFFFFFu) {
+            alignas(32) uint8_t block[32];
+            _mm256_store_si256((__m256i*)block, conf);
+            int block_min = *min_element(block, block + 32);
+            if (block_min < pick.min_conf) {
+                lowerMin(pick, block_min);
+                min_conf = _mm256_set1_epi8((char)pick.min_conf);
+            }
         }
-        if (conf == min_conf) {
-            min_conf_rows.push_back(row);
+        unsigned tied = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(conf, min_conf));
+        if (tied != 0) {
+            takeTies(pick, b.rng, row, tied);
+        }
+    }
+#elif QUEENS_LANES == 16
+    __m128i min_conf = _mm_set1_epi8((char)pick.min_conf);
+    for (; row + 16 <= n; row += 16) {
+        __m128i conf = _mm_loadu_si128((const __m128i*)(row_conf + row));
+        conf = _mm_adds_epu8(conf, _mm_loadu_si128((const __m128i*)(d2 + row)));
+        // Reverse the bytes: dwords, then the words in each dword, then
+        // the bytes in each word.
+        __m128i back = _mm_loadu_si128((const __m128i*)(d1 - row - 15));
+        back = _mm_shuffle_epi32(back, _MM_SHUFFLE(0, 1, 2, 3));
+        back = _mm_shufflehi_epi16(_mm_shufflelo_epi16(back, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        back = _mm_or_si128(_mm_slli_epi16(back, 8), _mm_srli_epi16(back, 8));
+        conf = _mm_adds_epu8(conf, back);
+        __m128i lower = _mm_cmpeq_epi8(_mm_min_epu8(conf, min_conf), min_conf);
+        if (_mm_movemask_epi8(lower) != 0xFFFF) {
+            alignas(16) uint8_t block[16];
+            _mm_store_si128((__m128i*)block, conf);
+            int block_min = *min_element(block, block + 16);
+            if (block_min < pick.min_conf) {
+                lowerMin(pick, block_min);
+                min_conf = _mm_set1_epi8((char)pick.min_conf);
+            }
         }
-        else if (conf < min_conf) {
-            min_conf = conf;
-            min_conf_rows = { row };
+        unsigned tied = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(conf, min_conf));
+        if (tied != 0) {
+            takeTies(pick, b.rng, row, tied);
         }
     }
-    return min_conf_rows[rand() % min_conf_rows.size()];
+#endif
+    for (; row < n; row++) {
+        offerRow(pick, b.rng, row, min(row_conf[row] + d1[-row] + d2[row], (int)UINT8_MAX));
+    }
+
+    b.row_conf[cur_row]++;
+    b.diag1[col - cur_row + n - 1]++;
+    b.diag2[col + cur_row]++;
+    return pick.row;
 }
 
-void moveQueen(int row, int col) {
-    int old_row = q_pos[col];
-    row_conf[old_row]--;
-    diag1[col - old_row + n - 1]--;
-    diag2[col + old_row]--;
+void moveQueen(Board& b, int row, int col) {
+    int n = b.n;
+    int old_row = b.q_pos[col];
+    b.row_conf[old_row]--;
+    b.diag1[col - old_row + n - 1]--;
+    b.diag2[col + old_row]--;
 
-    q_pos[col] = row;
-    row_conf[row]++;
-    diag1[col - row + n - 1]++;
-    diag2[col + row]++;
-}
+    b.q_pos[col] = row;
+    b.row_conf[row]++;
+    b.diag1[col - row + n - 1]++;
+    b.diag2[col + row]++;
 
-void minConflicts() {
-    int steps = 0;
-    int max_steps = n;
-    while (steps++ <= max_steps) {
-        int col = getMaxConfCol();
-        if (!has_conflicts) break;
-        int row = getMinConfRow(col);
-        moveQueen(row, col);
+    // Only pairs with this queen changed, so it alone needs adding; if
+    // it is now safe it is dropped when next drawn.
+    if (isConflicted(b, col)) {
+        addConfCol(b, col);
     }
-    if (has_conflicts) {
-        minConflicts();
+}
+
+// Repairs the board for up to step_budget steps, then restarts from a
+// random permutation with a budget half again as large, at most
+// max_restarts times (negative for no limit).
+bool minConflicts(Board& b, long long step_budget, long long max_restarts) {
+    long long budget = step_budget;
+    initQueens(b);
+    for (long long attempt = 0; max_restarts < 0 || attempt <= max_restarts; attempt++) {
+        if (attempt > 0) {
+            shuffleQueens(b);
+            budget += budget / 2;
+        }
+        // Moves only track the moved queen, so its partners can drop out
+        // of the set. Once as many steps have passed as there were
+        // conflicted columns, a rescan brings them back; it costs no
+        // more than the row scans of those steps.
+        initConfCols(b);
+        uint32_t scanned = b.conf_count;
+        uint32_t since_scan = 0;
+        for (long long steps = 0; ; steps++) {
+            if (since_scan++ >= scanned) {
+                initConfCols(b);
+                scanned = b.conf_count;
+                since_scan = 1;
+            }
+            if (solved.load(memory_order_relaxed)) return false;
+            int col = getConfCol(b);
+            if (col < 0) return !solved.exchange(true);
+            if (steps >= budget) break;
+            moveQueen(b, getMinConfRow(b, col), col);
+        }
     }
+    return false;
 }
 
-void printQueens() {
+void printQueens(const Board& b) {
     cout << "[";
-    for (int i = 0; i < n; i++) {
-        cout << q_pos[i];
-        if (i < n - 1) {
+    for (int i = 0; i < b.n; i++) {
+        cout << b.q_pos[i];
+        if (i < b.n - 1) {
             cout << ", ";
         }
     }
     cout << "]" << endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    long long step_budget = 0;
+    long long max_restarts = -1;
+    uint64_t seed = random_device{}();
+    int threads = 1;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--steps" && i + 1 < argc) {
+            step_budget = max(1LL, atoll(argv[++i]));
+        }
+        else if (arg == "--restarts" && i + 1 < argc) {
+            max_restarts = atoll(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else {
+            cerr << "Usage: " << argv[0] << " [--steps S] [--restarts R] [--seed X] [--threads K]" << endl;
+            return 1;
+        }
+    }
+
+    int n;
     cin >> n;
 
     if (n < 4) {
         cout << -1 << endl;
         return 0;
     }
+    if (step_budget == 0) {
+        step_budget = max(2LL * n, 100LL);
+    }
 
-    q_pos = new int[n];
-    row_conf = new int[n] {0};
-    diag1 = new int[2 * n - 1]{ 0 };
-    diag2 = new int[2 * n - 1]{ 0 };
+    // Portfolio: every thread runs its own solver on its own board, with
+    // an RNG stream drawn from the seed, and the first one done wins.
+    vector<Board> boards(threads);
+    Rng seeder = { seed };
+    for (auto& board : boards) {
+        allocateBoard(board, n);
+        board.rng.state = seeder.next();
+    }
+    atomic<int> winner(-1);
 
-    has_conflicts = true;
     auto start = high_resolution_clock::now();
 
-    initQueens();
-    minConflicts();
+    auto run = [&](int t) {
+        if (minConflicts(boards[t], step_budget, max_restarts)) {
+            winner = t;
+        }
+    };
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back(run, t);
+    }
+    run(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
 
     auto end = high_resolution_clock::now();
     double exec_time = duration_cast<chrono::duration<double>>(end - start).count();
 
-    if (n > 100) {
+    if (winner < 0) {
+        cout << -1 << endl;
+    }
+    else if (n > 100) {
         if (exec_time < 0.01) {
             cout  << fixed << setprecision(5) << exec_time << endl;
         }
@@ -133,12 +483,11 @@ int main() {
         }
     }
     else {
-        printQueens();
+        printQueens(boards[winner]);
     }
 
-    delete[] q_pos;
-    delete[] row_conf;
-    delete[] diag1;
-    delete[] diag2;
+    for (auto& board : boards) {
+        freeBoard(board);
+    }
     return 0;
 }